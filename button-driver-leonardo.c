@@ -25,12 +25,13 @@
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
-#include <util/delay.h>
 #include <inttypes.h>
 
 #include "common.h"
 #include "button-driver.h"
+#include "button-events.h"
 
 
 /* ------------------------------------------------------------------ *
@@ -44,30 +45,101 @@
  * ------------------------------------------------------------------ */
 #define PINF_MASK	((1<<PINF0) | (1<<PINF1) | (1<<PINF5) | (1<<PINF6) | (1<<PINF7))
 
+/* ------------------------------------------------------------------ *
+ *
+ * Debounce. Timer0 samples the inputs at BUTTON_SAMPLE_HZ and each key
+ * bit has its own integrator: it counts up while the input is active
+ * and down while it isn't, and the debounced state only flips at the
+ * ends of the range. BUTTON_GetKey just reads the result.
+ *
+ * ------------------------------------------------------------------ */
+#ifndef BUTTON_SAMPLE_HZ
+#define BUTTON_SAMPLE_HZ		1000
+#endif
+/* samples (ms at 1kHz) an input must settle for before it changes */
+#ifndef BUTTON_DEBOUNCE_SAMPLES
+#define BUTTON_DEBOUNCE_SAMPLES	20
+#endif
+/* KEY_OPEN .. KEY_MENU */
+#define BUTTON_INPUTS			5
+
+#define BUTTON_TIMER_PRESCALE	64
+#define BUTTON_OCR0A			((F_CPU / BUTTON_TIMER_PRESCALE / BUTTON_SAMPLE_HZ) - 1)
+#if BUTTON_OCR0A > 255
+#error "BUTTON_SAMPLE_HZ too low for Timer0 at this F_CPU"
+#endif
+
+static uint8_t button_level[BUTTON_INPUTS];
+static volatile uint8_t button_state = KEY_NONE;
+static uint16_t button_tick = 0;	/* ms */
+
+/* ------------------------------------------------------------------ *
+ *
+ * PINF bits 0,1,5,6,7 packed into a 5 bit index (F0 F1 F5 F6 F7 ->
+ * bits 0-4) and mapped to the KEY_ bits, so every active input is
+ * reported from one read of the port.
+ *
+ * ------------------------------------------------------------------ */
+#define PINF_INDEX(p)	(((p) & 0x03) | (((p) >> 3) & 0x1c))
+
+#define F0	KEY_DOOR_CLOSED
+#define F1	KEY_DOOR_OPEN
+#define F5	KEY_CLOSE
+#define F6	KEY_MENU
+#define F7	KEY_OPEN
+
+static const uint8_t button_lut[32] PROGMEM = {
+	0,				F0,				F1,				F1|F0,
+	F5,				F5|F0,			F5|F1,			F5|F1|F0,
+	F6,				F6|F0,			F6|F1,			F6|F1|F0,
+	F6|F5,			F6|F5|F0,		F6|F5|F1,		F6|F5|F1|F0,
+	F7,				F7|F0,			F7|F1,			F7|F1|F0,
+	F7|F5,			F7|F5|F0,		F7|F5|F1,		F7|F5|F1|F0,
+	F7|F6,			F7|F6|F0,		F7|F6|F1,		F7|F6|F1|F0,
+	F7|F6|F5,		F7|F6|F5|F0,	F7|F6|F5|F1,	F7|F6|F5|F1|F0
+};
+
+#undef F0
+#undef F1
+#undef F5
+#undef F6
+#undef F7
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t button_read_keys (void)
 {
-	uint8_t	key = KEY_NONE;
+	/* inputs are active low */
 	uint8_t buttons = ~PINF;
 
-	/* check buttons */
-	if (buttons & (1<<PINF7)) {
-		key |= KEY_OPEN;
-	}
-	else if (buttons & (1<<PINF5)) {
-		key |= KEY_CLOSE;
-	}
-	else if (buttons & (1<<PINF6)) {
-		key |= KEY_MENU;
-	}
-	else if (buttons & (1<<PINF1)) {
-		key |= KEY_DOOR_OPEN;
-	}
-	else if (buttons & (1<<PINF0)) {
-		key |= KEY_DOOR_CLOSED;
+	return pgm_read_byte(&button_lut[PINF_INDEX(buttons)]);
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+ISR(TIMER0_COMPA_vect)
+{
+	uint8_t raw = button_read_keys();
+	uint8_t state = button_state;
+	uint8_t bit, mask;
+
+	for (bit = 0, mask = 0x01; bit < BUTTON_INPUTS; bit++, mask <<= 1) {
+		if (raw & mask) {
+			if (button_level[bit] < BUTTON_DEBOUNCE_SAMPLES) {
+				if (++button_level[bit] == BUTTON_DEBOUNCE_SAMPLES) {
+					state |= mask;
+				}
+			}
+		}
+		else if (button_level[bit]) {
+			if (--button_level[bit] == 0) {
+				state &= ~mask;
+			}
+		}
 	}
-	return key;
+	button_state = state;
+
+	button_event_update (state, ++button_tick);
 }
 
 /* ------------------------------------------------------------------ */
@@ -77,30 +149,19 @@ void BUTTON_Init(void)
 	/* setup port directions */
 	DDRF &= ~(PINF_MASK);
 	PORTF |= PINF_MASK; /* enable pullup */
+
+	/* Timer0 CTC, sample tick for the debounce */
+	TCCR0A = (1<<WGM01);
+	TCCR0B = (1<<CS01) | (1<<CS00);	/* clk/64 */
+	OCR0A = BUTTON_OCR0A;
+	TIMSK0 = (1<<OCIE0A);
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t BUTTON_GetKey(void)
 {
-	uint8_t k = KEY_NONE;
-	uint8_t	key1 = KEY_NONE;
-	uint8_t key2 = KEY_NONE;
-
-	/* read key */
-	key1 = button_read_keys();
-
-	/* Handle debounce!! */
-	_delay_ms(50);
-
-	/* read key again */
-	key2 = button_read_keys();
-
-	if ((key1 == key2) && (key1 != KEY_NONE)) {
-		k = key1;
-	}
-
-	return k;
+	return button_state;
 }
 
 /* EOF */
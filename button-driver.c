@@ -25,20 +25,13 @@
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 #include <avr/io.h>
-#ifdef USE_INTERRUPT
 #include <avr/interrupt.h>
-#endif /* #ifdef USE_INTERRUPT */
 #include <avr/pgmspace.h>
-#include <util/delay.h>
 #include <inttypes.h>
 
 #include "common.h"
 #include "button-driver.h"
-
-#ifdef USE_INTERRUPT
-volatile uint8_t KEY = KEY_NONE;
-volatile bool KEY_VALID = FALSE;
-#endif /* #ifdef USE_INTERRUPT */
+#include "button-events.h"
 
 /* ------------------------------------------------------------------ *
  *
@@ -50,95 +43,147 @@ volatile bool KEY_VALID = FALSE;
  * Door Closed : PORTD7 [Di7]
  * Test 1      : PORTD2 [Di2]
  * Test 2      : PORTD4 [Di4]
+ *
+ * Test 1/2 share their pins with the board's LEDs, so they have no pin
+ * change interrupt: the heartbeat would keep waking the debounce.
  * ------------------------------------------------------------------ */
 #define PIND_MASK	((1<<PIND2) | (1<<PIND4) | (1<<PIND7))
 #define PINC_MASK	((1<<PINC1) | (1<<PINC3) | (1<<PINC4))
 #define PINB_MASK	(1<<PINB0)
 
+/* ------------------------------------------------------------------ *
+ *
+ * Debounce. Timer0 samples the inputs at BUTTON_SAMPLE_HZ and each key
+ * bit has its own integrator: it counts up while the input is active
+ * and down while it isn't, and the debounced state only flips at the
+ * ends of the range. BUTTON_GetKey just reads the result.
+ *
+ * With USE_INTERRUPT the timer only runs while it has work to do: a
+ * pin change starts it, and it stops itself once every input has
+ * settled and no key is held.
+ *
+ * ------------------------------------------------------------------ */
+#ifndef BUTTON_SAMPLE_HZ
+#define BUTTON_SAMPLE_HZ		1000
+#endif
+/* samples (ms at 1kHz) an input must settle for before it changes */
+#ifndef BUTTON_DEBOUNCE_SAMPLES
+#define BUTTON_DEBOUNCE_SAMPLES	20
+#endif
+/* KEY_OPEN .. KEY_MENU */
+#define BUTTON_INPUTS			5
+
+#define BUTTON_TIMER_PRESCALE	64
+#define BUTTON_OCR0A			((F_CPU / BUTTON_TIMER_PRESCALE / BUTTON_SAMPLE_HZ) - 1)
+#if BUTTON_OCR0A > 255
+#error "BUTTON_SAMPLE_HZ too low for Timer0 at this F_CPU"
+#endif
+
+static uint8_t button_level[BUTTON_INPUTS];
+static volatile uint8_t button_state = KEY_NONE;
+static uint16_t button_tick = 0;	/* ms (while running) */
+
+#define Button_TimerStart()		(TCCR0B = (1<<CS01) | (1<<CS00))	/* clk/64 */
+#define Button_TimerStop()		(TCCR0B = 0)
+
+/* ------------------------------------------------------------------ *
+ *
+ * The three keys are PINC bits 1,3,4, packed into a 3 bit index
+ * (C1 C3 C4 -> bits 0-2) and mapped to their KEY_ bits. The limit
+ * switches are a single pin each. Each port is read once, and every
+ * active input is reported.
+ *
+ * ------------------------------------------------------------------ */
+#define PINC_INDEX(p)	((((p) >> 1) & 0x01) | (((p) >> 2) & 0x06))
+
+static const uint8_t button_lut[8] PROGMEM = {
+	KEY_NONE,
+	KEY_OPEN,
+	KEY_CLOSE,
+	KEY_CLOSE | KEY_OPEN,
+	KEY_MENU,
+	KEY_MENU | KEY_OPEN,
+	KEY_MENU | KEY_CLOSE,
+	KEY_MENU | KEY_CLOSE | KEY_OPEN
+};
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t button_read_keys (void)
 {
-	uint8_t	key = KEY_NONE;
-
+	/* inputs are active low, Test 1/2 (PD2/PD4) aren't reported */
 	uint8_t buttons = ~PINC;
 	uint8_t portb = ~PINB;
 	uint8_t portd = ~PIND;
+	uint8_t key;
 
-	/* check buttons */
-	if (buttons & (1<<PINC1)) {
-		key |= KEY_OPEN;
-	}
-	else if (buttons & (1<<PINC3)) {
-		key |= KEY_CLOSE;
-	}
-	else if (buttons & (1<<PINC4)) {
-		key |= KEY_MENU;
-	}
-	else if (portd & (1<<PIND2)) {
-		// Test 1
-	}
-	else if (portd & (1<<PIND4)) {
-		// Test 2
-	}
-	else if (portd & (1<<PIND7)) {
+	key = pgm_read_byte(&button_lut[PINC_INDEX(buttons)]);
+	if (portd & (1<<PIND7)) {
 		key |= KEY_DOOR_CLOSED;
 	}
-	else if (portb & (1<<PINB0)) {
+	if (portb & (1<<PINB0)) {
 		key |= KEY_DOOR_OPEN;
 	}
 
 	return key;
 }
 
-#ifdef USE_INTERRUPT
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
-void button_change_interrupt(void)
+ISR(TIMER0_COMPA_vect)
 {
-	uint8_t	key1 = KEY_NONE;
-	uint8_t key2 = KEY_NONE;
-
-	/* read key */
-	key1 = button_read_keys();
-
-	/* Handle debounce!! */
-	_delay_ms(50);
-
-	/* read key again */
-	key2 = button_read_keys();
+	uint8_t raw = button_read_keys();
+	uint8_t state = button_state;
+	uint8_t bit, mask;
+#ifdef USE_INTERRUPT
+	uint8_t settled = TRUE;
+#endif /* #ifdef USE_INTERRUPT */
 
-	if ((key1 == key2) && (key1 != KEY_NONE)) {
-		if (!KEY_VALID) {
-			/* Store key in global key buffer */
-			KEY = key1;
-			KEY_VALID = TRUE;
+	for (bit = 0, mask = 0x01; bit < BUTTON_INPUTS; bit++, mask <<= 1) {
+		if (raw & mask) {
+			if (button_level[bit] < BUTTON_DEBOUNCE_SAMPLES) {
+				if (++button_level[bit] == BUTTON_DEBOUNCE_SAMPLES) {
+					state |= mask;
+				}
+			}
+		}
+		else if (button_level[bit]) {
+			if (--button_level[bit] == 0) {
+				state &= ~mask;
+			}
+		}
+#ifdef USE_INTERRUPT
+		if (button_level[bit] && (button_level[bit] != BUTTON_DEBOUNCE_SAMPLES)) {
+			settled = FALSE;
 		}
+#endif /* #ifdef USE_INTERRUPT */
 	}
+	button_state = state;
 
-	/* Delete pin change interrupt flags */
-	PCIFR = ((1<<PCIF2) | (1<<PCIF1) | (1<<PCIF0));
-}
+	button_event_update (state, ++button_tick);
 
+#ifdef USE_INTERRUPT
+	/* a held key still needs the tick for long press and repeat */
+	if (settled && !(state & KEY_BUTTONS)) {
+		Button_TimerStop();
+	}
+#endif /* #ifdef USE_INTERRUPT */
+}
 
-/* ------------------------------------------------------------------ */
-/* ------------------------------------------------------------------ */
+#ifdef USE_INTERRUPT
+/* ------------------------------------------------------------------ *
+ *
+ * Any edge just (re)starts the sample tick, the debounce itself is
+ * done there. A change that lands while the tick is stopping leaves
+ * its flag set, so this runs again straight after.
+ *
+ * ------------------------------------------------------------------ */
 ISR(PCINT0_vect)
 {
-    button_change_interrupt();
-}
-/* ------------------------------------------------------------------ */
-/* ------------------------------------------------------------------ */
-ISR(PCINT1_vect)
-{
-    button_change_interrupt();
-}
-/* ------------------------------------------------------------------ */
-/* ------------------------------------------------------------------ */
-ISR(PCINT2_vect)
-{
-    button_change_interrupt();
+	Button_TimerStart();
 }
+ISR(PCINT1_vect, ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect, ISR_ALIASOF(PCINT0_vect));
 #endif /* #ifdef USE_INTERRUPT */
 
 /* ------------------------------------------------------------------ */
@@ -157,47 +202,40 @@ void BUTTON_Init(void)
 	/* setup interrupts */
 	PCMSK0 |= (1<<PCINT0);
 	PCMSK1 |= ((1<<PCINT9) | (1<<PCINT11) | (1<<PCINT12));
-	PCMSK2 |= ((1<<PCINT18) | (1<<PCINT20) | (1<<PCINT23)); // PD2 & PD4 & PD7
+	PCMSK2 |= (1<<PCINT23); // PD7
 
 	PCIFR = (1<<PCIF2) | (1<<PCIF1) | (1<<PCIF0);
 	PCICR = (1<<PCIE2) | (1<<PCIE1) | (1<<PCIE0);
 #endif /* #ifdef USE_INTERRUPT */
+
+	/* Timer0 CTC, sample tick for the debounce. Also started in the
+	 * interrupt build, to pick up switches already closed at power up */
+	TCCR0A = (1<<WGM01);
+	OCR0A = BUTTON_OCR0A;
+	TIMSK0 = (1<<OCIE0A);
+	Button_TimerStart();
 }
 
+#ifdef USE_INTERRUPT
+/* ------------------------------------------------------------------ *
+ *
+ * TRUE when nothing needs the I/O clock: the sample tick has stopped
+ * and the main loop has taken every event. A pin change wakes the
+ * core from sleep and starts the tick again.
+ *
+ * ------------------------------------------------------------------ */
+uint8_t BUTTON_Idle(void)
+{
+	return ((TCCR0B == 0) && !button_event_pending());
+}
+#endif /* #ifdef USE_INTERRUPT */
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t BUTTON_GetKey(void)
 {
-	uint8_t k = KEY_NONE;
-#ifdef USE_INTERRUPT
-    cli();
-
-	/* check for unread key in buffer */
-    if (KEY_VALID) {
-        k = KEY;
-        KEY_VALID = FALSE;
-    }
-
-    sei();
-#else
-	uint8_t	key1 = KEY_NONE;
-	uint8_t key2 = KEY_NONE;
-
-	/* read key */
-	key1 = button_read_keys();
-
-	/* Handle debounce!! */
-	_delay_ms(50);
-
-	/* read key again */
-	key2 = button_read_keys();
-
-	if ((key1 == key2) && (key1 != KEY_NONE)) {
-		k = key1;
-	}
-#endif /* #ifdef USE_INTERRUPT */
-
-	return k;
+	/* single byte, no need to mask interrupts */
+	return button_state;
 }
 
 /* EOF */
@@ -33,9 +33,31 @@ enum {
 	KEY_MENU		= 0x10  /* Menu Key */
 };
 
+/* keys are edge triggered by the main loop, limit switches are levels */
+#define KEY_BUTTONS		(KEY_OPEN | KEY_CLOSE | KEY_MENU)
+#define KEY_LIMITS		(KEY_DOOR_OPEN | KEY_DOOR_CLOSED)
+
+/* key events */
+enum {
+	KEY_EVENT_PRESS = 0,
+	KEY_EVENT_RELEASE,
+	KEY_EVENT_LONG,		/* held for BUTTON_LONG_MS, sent once */
+	KEY_EVENT_REPEAT	/* auto-repeat while held */
+};
+
+typedef struct {
+	uint8_t		m_type;
+	uint8_t		m_key;
+	uint16_t	m_tick;		/* ms, wraps */
+} key_event_t;
+
 /* Public Functions */
 void    BUTTON_Init(void);
 uint8_t BUTTON_GetKey(void);
+uint8_t BUTTON_GetEvent(key_event_t *event);
+#ifdef USE_INTERRUPT
+uint8_t BUTTON_Idle(void);
+#endif /* #ifdef USE_INTERRUPT */
 
 #endif /* _BUTTON_DRIVER_H */
 
@@ -0,0 +1,177 @@
+/*
+ * Filename		: button-events.c
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: Key event queue shared by the button drivers.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+#include <avr/io.h>
+#include <inttypes.h>
+
+#include "common.h"
+#include "button-driver.h"
+#include "button-events.h"
+
+/* ------------------------------------------------------------------ *
+ *
+ * Timing (ms). A held key sends KEY_EVENT_LONG once after
+ * BUTTON_LONG_MS. Keys in BUTTON_REPEAT_KEYS also send KEY_EVENT_REPEAT,
+ * first after BUTTON_REPEAT_DELAY_MS, then every BUTTON_REPEAT_START_MS
+ * shrinking by a quarter each time down to BUTTON_REPEAT_MIN_MS. With
+ * the defaults 00 to 59 takes about a second of holding.
+ *
+ * ------------------------------------------------------------------ */
+#ifndef BUTTON_LONG_MS
+#define BUTTON_LONG_MS			1000
+#endif
+#ifndef BUTTON_REPEAT_DELAY_MS
+#define BUTTON_REPEAT_DELAY_MS	250
+#endif
+#ifndef BUTTON_REPEAT_START_MS
+#define BUTTON_REPEAT_START_MS	100
+#endif
+#ifndef BUTTON_REPEAT_MIN_MS
+#define BUTTON_REPEAT_MIN_MS	10
+#endif
+#ifndef BUTTON_REPEAT_KEYS
+#define BUTTON_REPEAT_KEYS		(KEY_OPEN | KEY_CLOSE)
+#endif
+
+#if BUTTON_REPEAT_START_MS > 255
+#error "BUTTON_REPEAT_START_MS must fit in 8 bits"
+#endif
+
+/* KEY_OPEN .. KEY_MENU */
+#define BUTTON_KEY_BITS			5
+
+/* ------------------------------------------------------------------ *
+ *
+ * Single producer (the driver's interrupt) single consumer (the main
+ * loop). Each side only writes its own index, and a byte write is
+ * atomic, so neither side has to mask interrupts.
+ *
+ * ------------------------------------------------------------------ */
+/* must be a power of 2 */
+#define BUTTON_EVENT_LEN		8
+#define BUTTON_EVENT_MASK		(BUTTON_EVENT_LEN - 1)
+
+static volatile key_event_t button_events[BUTTON_EVENT_LEN];
+static volatile uint8_t button_event_head = 0;	/* written by the producer */
+static volatile uint8_t button_event_tail = 0;	/* written by the consumer */
+
+/* hold tracking for each key bit */
+static uint8_t button_last = KEY_NONE;
+static uint8_t button_long_sent = 0;
+static uint16_t button_held_since[BUTTON_KEY_BITS];
+static uint16_t button_repeat_at[BUTTON_KEY_BITS];
+static uint8_t button_repeat_step[BUTTON_KEY_BITS];
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void button_event_push(uint8_t type, uint8_t key, uint16_t tick)
+{
+	uint8_t head = button_event_head;
+	uint8_t next = (head + 1) & BUTTON_EVENT_MASK;
+
+	if (next == button_event_tail) {
+		/* main loop is behind, drop the newest */
+		return;
+	}
+	button_events[head].m_type = type;
+	button_events[head].m_key = key;
+	button_events[head].m_tick = tick;
+	button_event_head = next;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void button_event_update(uint8_t state, uint16_t tick)
+{
+	uint8_t changed = (state ^ button_last) & KEY_BUTTONS;
+	uint8_t bit, mask;
+
+	if (!((state | button_last) & KEY_BUTTONS)) {
+		/* nothing held, nothing to time */
+		return;
+	}
+	for (bit = 0, mask = 0x01; bit < BUTTON_KEY_BITS; bit++, mask <<= 1) {
+		if (!(mask & KEY_BUTTONS)) {
+			/* limit switches are read as levels */
+			continue;
+		}
+		if (changed & mask) {
+			if (state & mask) {
+				button_event_push (KEY_EVENT_PRESS, mask, tick);
+				button_held_since[bit] = tick;
+				button_repeat_at[bit] = tick + BUTTON_REPEAT_DELAY_MS;
+				button_repeat_step[bit] = BUTTON_REPEAT_START_MS;
+				button_long_sent &= ~mask;
+			}
+			else {
+				button_event_push (KEY_EVENT_RELEASE, mask, tick);
+			}
+		}
+		else if (state & mask) {
+			if (!(button_long_sent & mask) &&
+					((uint16_t)(tick - button_held_since[bit]) >= BUTTON_LONG_MS)) {
+				button_event_push (KEY_EVENT_LONG, mask, tick);
+				button_long_sent |= mask;
+			}
+			if ((mask & BUTTON_REPEAT_KEYS) &&
+					((int16_t)(tick - button_repeat_at[bit]) >= 0)) {
+				button_event_push (KEY_EVENT_REPEAT, mask, tick);
+				button_repeat_at[bit] += button_repeat_step[bit];
+				button_repeat_step[bit] -= button_repeat_step[bit] >> 2;
+				if (button_repeat_step[bit] < BUTTON_REPEAT_MIN_MS) {
+					button_repeat_step[bit] = BUTTON_REPEAT_MIN_MS;
+				}
+			}
+		}
+	}
+	button_last = state;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint8_t BUTTON_GetEvent(key_event_t *event)
+{
+	uint8_t tail = button_event_tail;
+
+	if (tail == button_event_head) {
+		return FALSE;
+	}
+	event->m_type = button_events[tail].m_type;
+	event->m_key = button_events[tail].m_key;
+	event->m_tick = button_events[tail].m_tick;
+	button_event_tail = (tail + 1) & BUTTON_EVENT_MASK;
+
+	return TRUE;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint8_t button_event_pending(void)
+{
+	return (button_event_tail != button_event_head);
+}
+
+/* EOF */
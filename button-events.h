@@ -0,0 +1,35 @@
+/*
+ * Filename		: button-events.h
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: Key event queue shared by the button drivers.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+#ifndef _BUTTON_EVENTS_H
+#define _BUTTON_EVENTS_H
+
+#include <inttypes.h>
+
+/* called by the driver whenever it has a new debounced key state */
+void button_event_update(uint8_t state, uint16_t tick);
+/* TRUE while the main loop has events still to take */
+uint8_t button_event_pending(void);
+
+#endif /* #ifndef _BUTTON_EVENTS_H */
+
+/* EOF */
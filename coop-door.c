@@ -28,6 +28,9 @@
 #include <avr/pgmspace.h>
 #include <avr/interrupt.h>
 #include <util/delay.h>
+#ifdef RTC_TIMER2_ASYNC
+#include <avr/sleep.h>
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
@@ -40,9 +43,30 @@
 #include "lcd-driver.h"
 #include "rtc.h"
 #include "data-store.h"
+#include "soft-timer.h"
+#include "sun-times.h"
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 
+#if defined(CLOCK_BIG_DIGITS) && defined(CLOCK_SHOW_SECONDS)
+#error "CLOCK_BIG_DIGITS has no room for seconds"
+#endif
+
+#if defined(RTC_DS1307_SQW) && defined(LEONARDO_BOARD) && defined(USE_MOTOR_CHANNEL_B)
+#error "RTC_DS1307_SQW uses PE6 (D7), motor channel B's direction pin"
+#endif
+
+#if defined(RTC_TIMER2_ASYNC) && !defined(USE_INTERRUPT)
+#error "RTC_TIMER2_ASYNC sleeps, the buttons need USE_INTERRUPT to wake it"
+#endif
+
+/* timeouts, ms */
+#define MENU_TIMEOUT_MS			20000UL
+#define HEARTBEAT_MS			1000UL
+/* open limit switch ignored while the door first moves */
+#define INHIBIT_ERROR_OPEN_MS	2000UL
+#define INHIBIT_CLOSE_MS		5000UL
+
 
 // LEDs on POP-168 board: PD2 (Di2) & PD4 (Di4) - Tided high
 // Switches on POP-168 board: PD2 (Di2) & PD4 (Di4)
@@ -117,23 +141,28 @@
 typedef struct {
 	uint8_t 	m_enter;
 	uint8_t 	m_key;
+	uint8_t		m_repeat;
+	uint8_t		m_limits;
 	uint8_t 	m_menu_state;
 	uint8_t 	m_setup_change_state;
 	uint8_t		m_door_mode;
 	uint8_t		m_door_state;
-	uint32_t	m_menu_timeout;
+	timer_handle_t	m_menu_timer;
 	uint8_t		m_temp;
-	uint8_t		m_open_sw_inhibit;
+	int16_t		m_tzOffset;		/* zone being set, minutes */
+	uint8_t		m_tzRule;
+	timer_handle_t	m_open_sw_inhibit;
 #ifdef LEONARDO_BOARD
-	uint8_t		m_lcdBacklight_timeout;
-	uint32_t	m_lcdBacklight_timeout_count;
+	uint8_t		m_lcdBacklight_timeout;	/* seconds */
+	timer_handle_t	m_lcdBacklight_timer;
 #endif /* #ifdef LEONARDO_BOARD */
 #ifdef DS1307_BOARD
 	uint8_t		m_lastHour;
-	uint8_t		m_lastDay;
-	rtc_date_t	m_date;
 #endif /* #ifdef DS1307_BOARD */
+	uint16_t	m_lastDays;
+	rtc_date_t	m_date;
 	rtc_time_t 	m_time;
+	rtc_snapshot_t	m_now;
 } state_params_t;
 
 enum {
@@ -153,14 +182,14 @@ uint8_t idleStateError(state_params_t *params);
 uint8_t setupMenu(state_params_t *params);
 uint8_t exitMenu(state_params_t *params);
 uint8_t setupMenu_mode(state_params_t *params);
+uint8_t setupMenu_zone(state_params_t *params);
 uint8_t setupMenu_clock(state_params_t *params);
-#ifdef DS1307_BOARD
 uint8_t setupMenu_date(state_params_t *params);
-#endif /* #ifdef DS1307_BOARD */
 uint8_t setupMenu_open_al(state_params_t *params);
 uint8_t setupMenu_close_al(state_params_t *params);
 uint8_t doorOpening(state_params_t *params);
 uint8_t doorClosing(state_params_t *params);
+void loadAlarmTimes(uint8_t doorMode);
 
 enum {
 	ST_IDLE = 0,
@@ -168,10 +197,9 @@ enum {
 	ST_SETUP_MENU,
 	ST_EXIT_MENU,
 	ST_SETUP_MENU_MODE,
+	ST_SETUP_MENU_ZONE,
 	ST_SETUP_MENU_CLOCK,
-#ifdef DS1307_BOARD
 	ST_SETUP_MENU_DATE,
-#endif /* #ifdef DS1307_BOARD */
 	ST_SETUP_MENU_OPEN_AL,
 	ST_SETUP_MENU_CLOSE_AL,
 	ST_DOOR_OPENING,
@@ -185,31 +213,41 @@ func_p states[ST_MAX] = {idleState,
 						setupMenu,
 						exitMenu,
 						setupMenu_mode,
+						setupMenu_zone,
 						setupMenu_clock,
-#ifdef DS1307_BOARD
 						setupMenu_date,
-#endif /* #ifdef DS1307_BOARD */
 						setupMenu_open_al,
 						setupMenu_close_al,
 						doorOpening,
 						doorClosing};
 
-#ifdef DS1307_BOARD
-#define MENU_STATE_MAX 6
+#define MENU_STATE_MAX 7
 uint8_t menu_states[MENU_STATE_MAX] = {ST_EXIT_MENU,
 									   ST_SETUP_MENU_MODE,
+									   ST_SETUP_MENU_ZONE,
 									   ST_SETUP_MENU_CLOCK,
 									   ST_SETUP_MENU_DATE,
 									   ST_SETUP_MENU_OPEN_AL,
 									   ST_SETUP_MENU_CLOSE_AL};
-#else
-#define MENU_STATE_MAX 5
-uint8_t menu_states[MENU_STATE_MAX] = {ST_EXIT_MENU,
-									   ST_SETUP_MENU_MODE,
-									   ST_SETUP_MENU_CLOCK,
-									   ST_SETUP_MENU_OPEN_AL,
-									   ST_SETUP_MENU_CLOSE_AL};
-#endif /* #ifdef DS1307_BOARD */
+
+/* ------------------------------------------------------------------ */
+/* UI text lives in flash, lines used on several screens are shared   */
+/* ------------------------------------------------------------------ */
+static const char str_blank[] PROGMEM		= "                ";
+static const char str_saving[] PROGMEM		= "Saving...       ";
+static const char str_press_menu[] PROGMEM	= "   Press Menu   ";
+
+/* standard time offsets in use, minutes east of UTC */
+#define TZ_OFFSET_MIN			(-12 * 60)
+#define TZ_OFFSET_MAX			(14 * 60)
+#define TZ_OFFSET_STEP			15
+static const char tz_rule_names[RTC_TZ_RULE_MAX][5] PROGMEM = {
+	"None", "EU  ", "US  ", "AU  "
+};
+
+/* door state icon, always in the top right corner */
+#define DOOR_ICON_LINE	0
+#define DOOR_ICON_POS	15
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
@@ -241,9 +279,12 @@ uint8_t nextMenu(uint8_t currentState, state_params_t *params)
 /* ------------------------------------------------------------------ */
 uint8_t SetTimeValue(uint8_t currentState, state_params_t *params)
 {
+	/* a held key steps the value as well */
+	uint8_t key = params->m_key | params->m_repeat;
+
 	if (params->m_enter) {
 		if (currentState == ST_SETUP_MENU_CLOCK) {
-			RTC_GetTime(&params->m_time);
+			params->m_time = params->m_now.m_time;
 		}
 		else if (currentState == ST_SETUP_MENU_OPEN_AL) {
 			DS_GetOpenAlarm(&params->m_time);
@@ -251,15 +292,15 @@ uint8_t SetTimeValue(uint8_t currentState, state_params_t *params)
 		else if (currentState == ST_SETUP_MENU_CLOSE_AL) {
 			DS_GetCloseAlarm(&params->m_time);
 		}
-		LCD_WriteLine(0, 16, "                ");
-		LCD_WriteLine(1, 16, "                ");
+		LCD_WriteLine_P(0, 16, str_blank);
+		LCD_WriteLine_P(1, 16, str_blank);
 		LCD_WriteTime(params->m_time);
 		LCD_SetCursor(LCD_CURSOR_HOUR);
 		LCD_SetCursor(LCD_CURSOR_HOUR);
 		params->m_enter = 0;
 	}
 
-	if (params->m_key == KEY_OPEN) {
+	if (key == KEY_OPEN) {
 		if (params->m_setup_change_state == 1) {
 			// update hour
 			params->m_time.m_hour++;
@@ -279,7 +320,7 @@ uint8_t SetTimeValue(uint8_t currentState, state_params_t *params)
 			LCD_SetCursor(LCD_CURSOR_MIN);
 		}
 	}
-	else if (params->m_key == KEY_CLOSE) {
+	else if (key == KEY_CLOSE) {
 		if (params->m_setup_change_state == 1) {
 			// update hour
 			params->m_time.m_hour--;
@@ -299,7 +340,7 @@ uint8_t SetTimeValue(uint8_t currentState, state_params_t *params)
 			LCD_SetCursor(LCD_CURSOR_MIN);
 		}
 	}
-	else if (params->m_key == KEY_MENU) {
+	else if (key == KEY_MENU) {
 		params->m_setup_change_state++;
 		if (params->m_setup_change_state == 2) {
 			// change LCD to min
@@ -308,17 +349,20 @@ uint8_t SetTimeValue(uint8_t currentState, state_params_t *params)
 		else if (params->m_setup_change_state == 3) {
 			// save time
 			LCD_SetCursor(LCD_CURSOR_OFF);
-			LCD_WriteLine(0, 16, "Saving...       ");
+			LCD_WriteLine_P(0, 16, str_saving);
+			LCD_Flush();
 			if (currentState == ST_SETUP_MENU_CLOCK) {
 				RTC_SetTime(&params->m_time);
 			}
 			else if (currentState == ST_SETUP_MENU_OPEN_AL) {
 				DS_SetOpenAlarm(&params->m_time);
-				RTC_SetOpenTime(&params->m_time);
 			}
 			else if (currentState == ST_SETUP_MENU_CLOSE_AL) {
 				DS_SetCloseAlarm(&params->m_time);
-				RTC_SetCloseTime(&params->m_time);
+			}
+			if (currentState != ST_SETUP_MENU_CLOCK) {
+				/* in light mode the sun still sets the alarms */
+				loadAlarmTimes(params->m_door_mode);
 			}
 			params->m_setup_change_state = 4;
 		}
@@ -326,37 +370,45 @@ uint8_t SetTimeValue(uint8_t currentState, state_params_t *params)
 	return currentState;
 }
 
-#ifdef DS1307_BOARD
+/* ------------------------------------------------------------------ */
+/* a day past the end of a shorter month (or February) moves back to  */
+/* its last day, so the date saved is the date shown                  */
+/* ------------------------------------------------------------------ */
+void clampDay(rtc_date_t *date)
+{
+	uint8_t last = RTC_DaysInMonth(date);
+
+	if (date->m_day > last) {
+		date->m_day = last;
+	}
+}
+
 uint8_t SetDateValue(uint8_t currentState, state_params_t *params)
 {
+	/* a held key steps the value as well */
+	uint8_t key = params->m_key | params->m_repeat;
+
 	if (params->m_enter) {
 		if (currentState == ST_SETUP_MENU_DATE) {
 			RTC_GetDate(&params->m_date);
 		}
-		LCD_WriteLine(0, 16, "                ");
-		LCD_WriteLine(1, 16, "                ");
+		LCD_WriteLine_P(0, 16, str_blank);
+		LCD_WriteLine_P(1, 16, str_blank);
 		LCD_WriteDate(params->m_date);
-		LCD_SetCursor(LCD_CURSOR_DAYNAME);
-		LCD_SetCursor(LCD_CURSOR_DAYNAME);
+		/* the day name follows from the date, start on the day */
+		params->m_setup_change_state = 2;
+		LCD_SetCursor(LCD_CURSOR_DAY);
 		params->m_enter = 0;
 	}
 
-	if (params->m_key == KEY_OPEN) {
-		if (params->m_setup_change_state == 1) {
-			// update day name
-			params->m_date.m_dayNumber++;
-			if (params->m_date.m_dayNumber == 8) {
-				params->m_date.m_dayNumber = 1;
-			}
-			LCD_WriteDate(params->m_date);
-			LCD_SetCursor(LCD_CURSOR_DAYNAME);
-		}
-		else if (params->m_setup_change_state == 2) {
+	if (key == KEY_OPEN) {
+		if (params->m_setup_change_state == 2) {
 			// update day
 			params->m_date.m_day++;
-			if (params->m_date.m_day == 32) {
+			if (params->m_date.m_day > RTC_DaysInMonth(&params->m_date)) {
 				params->m_date.m_day = 1;
 			}
+			RTC_DayOfWeek(&params->m_date);
 			LCD_WriteDate(params->m_date);
 			LCD_SetCursor(LCD_CURSOR_DAY);
 		}
@@ -366,6 +418,8 @@ uint8_t SetDateValue(uint8_t currentState, state_params_t *params)
 			if (params->m_date.m_month == 13) {
 				params->m_date.m_month = 1;
 			}
+			clampDay(&params->m_date);
+			RTC_DayOfWeek(&params->m_date);
 			LCD_WriteDate(params->m_date);
 			LCD_SetCursor(LCD_CURSOR_MONTH);
 		}
@@ -375,35 +429,31 @@ uint8_t SetDateValue(uint8_t currentState, state_params_t *params)
 			if (params->m_date.m_year == 100) {
 				params->m_date.m_year = 0;
 			}
+			clampDay(&params->m_date);
+			RTC_DayOfWeek(&params->m_date);
 			LCD_WriteDate(params->m_date);
 			LCD_SetCursor(LCD_CURSOR_YEAR);
 		}
 	}
-	else if (params->m_key == KEY_CLOSE) {
-		if (params->m_setup_change_state == 1) {
-			// update day name
-			params->m_date.m_dayNumber--;
-			if (params->m_date.m_dayNumber == 255) {
-				params->m_date.m_dayNumber = 7;
-			}
-			LCD_WriteDate(params->m_date);
-			LCD_SetCursor(LCD_CURSOR_DAYNAME);
-		}
-		else if (params->m_setup_change_state == 2) {
+	else if (key == KEY_CLOSE) {
+		if (params->m_setup_change_state == 2) {
 			// update day
 			params->m_date.m_day--;
-			if (params->m_date.m_day == 255) {
-				params->m_date.m_day = 31;
+			if (params->m_date.m_day == 0) {
+				params->m_date.m_day = RTC_DaysInMonth(&params->m_date);
 			}
+			RTC_DayOfWeek(&params->m_date);
 			LCD_WriteDate(params->m_date);
 			LCD_SetCursor(LCD_CURSOR_DAY);
 		}
 		else if (params->m_setup_change_state == 3) {
 			// update month
 			params->m_date.m_month--;
-			if (params->m_date.m_month == 255) {
+			if (params->m_date.m_month == 0) {
 				params->m_date.m_month = 12;
 			}
+			clampDay(&params->m_date);
+			RTC_DayOfWeek(&params->m_date);
 			LCD_WriteDate(params->m_date);
 			LCD_SetCursor(LCD_CURSOR_MONTH);
 		}
@@ -413,11 +463,13 @@ uint8_t SetDateValue(uint8_t currentState, state_params_t *params)
 			if (params->m_date.m_year == 255) {
 				params->m_date.m_year = 99;
 			}
+			clampDay(&params->m_date);
+			RTC_DayOfWeek(&params->m_date);
 			LCD_WriteDate(params->m_date);
 			LCD_SetCursor(LCD_CURSOR_YEAR);
 		}
 	}
-	else if (params->m_key == KEY_MENU) {
+	else if (key == KEY_MENU) {
 		params->m_setup_change_state++;
 		if (params->m_setup_change_state == 2) {
 			// change LCD to min
@@ -434,7 +486,8 @@ uint8_t SetDateValue(uint8_t currentState, state_params_t *params)
 		else if (params->m_setup_change_state == 5) {
 			// save date
 			LCD_SetCursor(LCD_CURSOR_OFF);
-			LCD_WriteLine(0, 16, "Saving...       ");
+			LCD_WriteLine_P(0, 16, str_saving);
+			LCD_Flush();
 			if (currentState == ST_SETUP_MENU_DATE) {
 				RTC_SetDate(&params->m_date);
 			}
@@ -444,18 +497,20 @@ uint8_t SetDateValue(uint8_t currentState, state_params_t *params)
 	return currentState;
 }
 
-#endif /* #ifdef DS1307_BOARD */
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t SetModeValue(uint8_t currentState, state_params_t *params)
 {
 	if (params->m_enter) {
-		LCD_WriteLine(0, 16, "=   Door Mode  =");
+		LCD_WriteLine_P(0, 16, PSTR("=   Door Mode  ="));
 		if (params->m_temp == DOOR_MODE_OPEN_CLOSE) {
-			LCD_WriteLine(1, 16, "   Open/Close   ");
+			LCD_WriteLine_P(1, 16, PSTR("   Open/Close   "));
 		}
 		else if (params->m_temp == DOOR_MODE_OPEN_ONLY) {
-			LCD_WriteLine(1, 16, "   Open Only    ");
+			LCD_WriteLine_P(1, 16, PSTR("   Open Only    "));
+		}
+		else if (params->m_temp == DOOR_MODE_LIGHT) {
+			LCD_WriteLine_P(1, 16, PSTR(" Sunrise/Sunset "));
 		}
 		params->m_enter = 0;
 	}
@@ -464,6 +519,9 @@ uint8_t SetModeValue(uint8_t currentState, state_params_t *params)
 		if (params->m_temp == DOOR_MODE_OPEN_CLOSE) {
 			params->m_temp = DOOR_MODE_OPEN_ONLY;
 		}
+		else if (params->m_temp == DOOR_MODE_OPEN_ONLY) {
+			params->m_temp = DOOR_MODE_LIGHT;
+		}
 		else {
 			params->m_temp = DOOR_MODE_OPEN_CLOSE;
 		}
@@ -472,13 +530,128 @@ uint8_t SetModeValue(uint8_t currentState, state_params_t *params)
 	else if (params->m_key == KEY_MENU) {
 		params->m_setup_change_state = 2;
 		params->m_door_mode = params->m_temp;
-		LCD_WriteLine(0, 16, "Saving...       ");
-		LCD_WriteLine(1, 16, "                ");
+		LCD_WriteLine_P(0, 16, str_saving);
+		LCD_WriteLine_P(1, 16, str_blank);
+		LCD_Flush();
+	}
+
+	return currentState;
+}
+
+/* ------------------------------------------------------------------ */
+/* zone being set, '>' marks the line the keys change                 */
+/* ------------------------------------------------------------------ */
+void showZone(state_params_t *params)
+{
+	char line[17];
+	uint16_t mins = (params->m_tzOffset < 0) ? -params->m_tzOffset : params->m_tzOffset;
+
+	strcpy_P(line, PSTR("  UTC+00:00     "));
+	if (params->m_setup_change_state == 1) {
+		line[0] = '>';
+	}
+	if (params->m_tzOffset < 0) {
+		line[5] = '-';
+	}
+	line[6] = '0' + (mins / 600);
+	line[7] = '0' + ((mins / 60) % 10);
+	line[9] = '0' + ((mins % 60) / 10);
+	line[10] = '0' + (mins % 10);
+	LCD_WriteLine(0, 16, line);
+
+	strcpy_P(line, PSTR("  Summer: None  "));
+	if (params->m_setup_change_state == 2) {
+		line[0] = '>';
+	}
+	memcpy_P(&line[10], tz_rule_names[params->m_tzRule], 4);
+	LCD_WriteLine(1, 16, line);
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint8_t SetZoneValue(uint8_t currentState, state_params_t *params)
+{
+	/* a held key steps the offset as well */
+	uint8_t key = params->m_key | params->m_repeat;
+
+	if (params->m_enter) {
+		showZone(params);
+		params->m_enter = 0;
+	}
+
+	if (params->m_setup_change_state == 1) {
+		// update offset
+		if ((key == KEY_OPEN) && (params->m_tzOffset <= (TZ_OFFSET_MAX - TZ_OFFSET_STEP))) {
+			params->m_tzOffset += TZ_OFFSET_STEP;
+			showZone(params);
+		}
+		else if ((key == KEY_CLOSE) && (params->m_tzOffset >= (TZ_OFFSET_MIN + TZ_OFFSET_STEP))) {
+			params->m_tzOffset -= TZ_OFFSET_STEP;
+			showZone(params);
+		}
+	}
+	else if (params->m_setup_change_state == 2) {
+		// update daylight saving rule
+		if (params->m_key == KEY_OPEN) {
+			params->m_tzRule++;
+			if (params->m_tzRule == RTC_TZ_RULE_MAX) {
+				params->m_tzRule = RTC_TZ_RULE_NONE;
+			}
+			showZone(params);
+		}
+		else if (params->m_key == KEY_CLOSE) {
+			if (params->m_tzRule == RTC_TZ_RULE_NONE) {
+				params->m_tzRule = RTC_TZ_RULE_MAX;
+			}
+			params->m_tzRule--;
+			showZone(params);
+		}
 	}
 
+	if (params->m_key == KEY_MENU) {
+		params->m_setup_change_state++;
+		if (params->m_setup_change_state == 3) {
+			// save zone, the clock keeps UTC so local time moves with it
+			LCD_WriteLine_P(0, 16, str_saving);
+			LCD_WriteLine_P(1, 16, str_blank);
+			LCD_Flush();
+			DS_SetTimezone(params->m_tzOffset, params->m_tzRule);
+			RTC_SetTimezone(params->m_tzOffset, params->m_tzRule);
+			/* in light mode the alarms follow the sun in local time */
+			loadAlarmTimes(params->m_door_mode);
+			params->m_setup_change_state = 4;
+		}
+		else {
+			showZone(params);
+		}
+	}
 	return currentState;
 }
 
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void showDoorState(uint8_t doorState)
+{
+	switch (doorState) {
+		case DOOR_STATE_OPEN:
+			LCD_WriteGlyph(DOOR_ICON_LINE, DOOR_ICON_POS, LCD_GLYPH_OPEN);
+			break;
+		case DOOR_STATE_CLOSED:
+			LCD_WriteGlyph(DOOR_ICON_LINE, DOOR_ICON_POS, LCD_GLYPH_CLOSED);
+			break;
+		case DOOR_STATE_OPENING:
+		case DOOR_STATE_CLOSING:
+			LCD_WriteGlyph(DOOR_ICON_LINE, DOOR_ICON_POS, LCD_GLYPH_MOVING);
+			break;
+		case DOOR_STATE_ERROR:
+			LCD_WriteGlyph(DOOR_ICON_LINE, DOOR_ICON_POS, LCD_GLYPH_ERROR);
+			break;
+		default:
+			/* unknown, leave the corner blank */
+			break;
+	}
+}
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t idleState(state_params_t *params)
@@ -487,49 +660,71 @@ uint8_t idleState(state_params_t *params)
 	rtc_time_t currentTime;
 
 	if (params->m_enter) {
+		LCD_SelectGlyphs(LCD_GLYPH_SET_STATUS);
+#ifdef CLOCK_BIG_DIGITS
+		LCD_WriteLine_P(0, 16, str_blank);
+		LCD_WriteLine_P(1, 16, str_blank);
+#else
 #ifdef CLOCK_SHOW_SECONDS
-		LCD_WriteLine(0, 16, "    --:--:--    ");
+		LCD_WriteLine_P(0, 16, PSTR("    --:--:--    "));
 #else
-		LCD_WriteLine(0, 16, "     --:--      ");
+		LCD_WriteLine_P(0, 16, PSTR("     --:--      "));
 #endif
-#ifdef DS1307_BOARD
 		LCD_WriteDate(params->m_date);
-#else
-		LCD_WriteLine(1, 16, "     cooljc     ");
-#endif
+#endif /* #ifdef CLOCK_BIG_DIGITS */
+		showDoorState(params->m_door_state);
 		MotorStop();
 		params->m_enter = 0;
 		lastUpdate = 60;
 	}
 
 
+	currentTime = params->m_now.m_time;
 #ifdef CLOCK_SHOW_SECONDS
-	if (lastUpdate != RTC_GetSecondTick()) {
-		RTC_GetTime (&currentTime);
+	if (lastUpdate != currentTime.m_sec) {
 		LCD_WriteTime(currentTime);
-		lastUpdate = RTC_GetSecondTick();
+		lastUpdate = currentTime.m_sec;
 	}
 #else
-	RTC_GetTime (&currentTime);
 	if (lastUpdate != currentTime.m_min) {
+#ifdef CLOCK_BIG_DIGITS
+		LCD_WriteBigTime(currentTime);
+#else
 		LCD_WriteTime(currentTime);
+#endif
 		lastUpdate = currentTime.m_min;
 	}
 #endif
 
 #ifdef DS1307_BOARD
-	/* check for day change - re-sync local RTC with external RTC */
+#ifndef RTC_DS1307_SQW
 	if (params->m_lastHour != currentTime.m_hour) {
 		params->m_lastHour = currentTime.m_hour;
-		RTC_GetDate(&params->m_date);
-		if (params->m_lastDay != params->m_date.m_dayNumber) {
-			/* Day has changed */
-			params->m_lastDay = params->m_date.m_dayNumber;
-			RTC_SyncTime();
-			LCD_WriteDate(params->m_date);
+		/* keep the local timebase trimmed to the DS1307 */
+		if (RTC_Calibrate()) {
+			DS_SetClockTrim(RTC_GetTrim());
 		}
 	}
+#endif /* #ifndef RTC_DS1307_SQW */
+#endif /* #ifdef DS1307_BOARD */
+
+	/* day change - the date comes from the local clock. With a DS1307
+	 * that isn't ticking it, re-sync the local clock with it first */
+	if (params->m_lastDays != params->m_now.m_days) {
+#if defined(DS1307_BOARD) && !defined(RTC_DS1307_SQW)
+		RTC_SyncTime();
+		RTC_GetSnapshot(&params->m_now);
+#endif /* #if defined(DS1307_BOARD) && !defined(RTC_DS1307_SQW) */
+		params->m_lastDays = params->m_now.m_days;
+		if (params->m_door_mode == DOOR_MODE_LIGHT) {
+			/* new day, new sunrise and sunset */
+			loadAlarmTimes(params->m_door_mode);
+		}
+		RTC_GetDate(&params->m_date);
+#ifndef CLOCK_BIG_DIGITS
+		LCD_WriteDate(params->m_date);
 #endif
+	}
 
 	if (params->m_key == KEY_MENU) {
 		return ST_EXIT_MENU;
@@ -552,8 +747,10 @@ uint8_t idleStateError(state_params_t *params)
 		MotorStop();
 		params->m_enter = 0;
 		// close error
-		LCD_WriteLine(0, 16, "Door Close Error");
-		LCD_WriteLine(1, 16, "Check for dirt! ");
+		LCD_WriteLine_P(0, 16, PSTR("Door Close Error"));
+		LCD_WriteLine_P(1, 16, PSTR("Check for dirt! "));
+		LCD_SelectGlyphs(LCD_GLYPH_SET_STATUS);
+		LCD_WriteGlyph(1, DOOR_ICON_POS, LCD_GLYPH_ERROR);
 	}
 	if (params->m_key == KEY_OPEN) {
 		return ST_DOOR_OPENING;
@@ -566,8 +763,8 @@ uint8_t idleStateError(state_params_t *params)
 uint8_t setupMenu(state_params_t *params)
 {
 	if (params->m_enter) {
-		LCD_WriteLine(0, 16, "==    Setup   ==");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("==    Setup   =="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -582,8 +779,8 @@ uint8_t setupMenu(state_params_t *params)
 uint8_t exitMenu(state_params_t *params)
 {
 	if (params->m_enter) {
-		LCD_WriteLine(0, 16, "==    Exit    ==");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("==    Exit    =="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -598,8 +795,8 @@ uint8_t exitMenu(state_params_t *params)
 uint8_t setupMenu_mode(state_params_t *params)
 {
 	if ((params->m_enter) && (params->m_setup_change_state == 0)) {
-		LCD_WriteLine(0, 16, "== Door Mode  ==");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("== Door Mode  =="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -610,6 +807,7 @@ uint8_t setupMenu_mode(state_params_t *params)
 		params->m_enter = 1;
 		params->m_setup_change_state = 0;
 		DS_SetAlarmMode(params->m_door_mode);
+		loadAlarmTimes(params->m_door_mode);
 		return ST_SETUP_MENU_MODE;
 	}
 
@@ -622,13 +820,44 @@ uint8_t setupMenu_mode(state_params_t *params)
 	return nextMenu(ST_SETUP_MENU_MODE, params);
 }
 
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint8_t setupMenu_zone(state_params_t *params)
+{
+	if ((params->m_enter) && (params->m_setup_change_state == 0)) {
+		LCD_WriteLine_P(0, 16, PSTR("== Time Zone  =="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
+		params->m_enter = 0;
+	}
+
+	if ((params->m_setup_change_state > 0) && (params->m_setup_change_state < 4)) {
+		return SetZoneValue(ST_SETUP_MENU_ZONE, params);
+	}
+	else if (params->m_setup_change_state == 4) {
+		params->m_enter = 1;
+		params->m_setup_change_state = 0;
+	}
+
+	if (params->m_key == KEY_MENU) {
+		params->m_enter = 1;
+		params->m_setup_change_state = 1;
+		DS_GetTimezone(&params->m_tzOffset, &params->m_tzRule);
+		if ((params->m_tzOffset < TZ_OFFSET_MIN) || (params->m_tzOffset > TZ_OFFSET_MAX)) {
+			params->m_tzOffset = 0;
+		}
+		return ST_SETUP_MENU_ZONE;
+	}
+
+	return nextMenu(ST_SETUP_MENU_ZONE, params);
+}
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t setupMenu_clock(state_params_t *params)
 {
 	if ((params->m_enter) && (params->m_setup_change_state == 0)) {
-		LCD_WriteLine(0, 16, "== Set Clock  ==");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("== Set Clock  =="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -648,14 +877,13 @@ uint8_t setupMenu_clock(state_params_t *params)
 
 	return nextMenu(ST_SETUP_MENU_CLOCK, params);
 }
-#ifdef DS1307_BOARD
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t setupMenu_date(state_params_t *params)
 {
 	if ((params->m_enter) && (params->m_setup_change_state == 0)) {
-		LCD_WriteLine(0, 16, "==  Set Date  ==");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("==  Set Date  =="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -675,14 +903,13 @@ uint8_t setupMenu_date(state_params_t *params)
 
 	return nextMenu(ST_SETUP_MENU_DATE, params);
 }
-#endif /* #ifdef DS1307_BOARD */
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t setupMenu_open_al(state_params_t *params)
 {
 	if ((params->m_enter) && (params->m_setup_change_state == 0)) {
-		LCD_WriteLine(0, 16, "=  Set Open AL =");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("=  Set Open AL ="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -708,8 +935,8 @@ uint8_t setupMenu_open_al(state_params_t *params)
 uint8_t setupMenu_close_al(state_params_t *params)
 {
 	if ((params->m_enter) && (params->m_setup_change_state == 0)) {
-		LCD_WriteLine(0, 16, "= Set Close AL =");
-		LCD_WriteLine(1, 16, "   Press Menu   ");
+		LCD_WriteLine_P(0, 16, PSTR("= Set Close AL ="));
+		LCD_WriteLine_P(1, 16, str_press_menu);
 		params->m_enter = 0;
 	}
 
@@ -740,8 +967,10 @@ uint8_t doorOpening(state_params_t *params)
 	}
 
 	if (params->m_enter) {
-		LCD_WriteLine(0, 16, "Door Opening... ");
-		LCD_WriteLine(1, 16, "                ");
+		LCD_WriteLine_P(0, 16, PSTR("Door Opening... "));
+		LCD_WriteLine_P(1, 16, str_blank);
+		LCD_SelectGlyphs(LCD_GLYPH_SET_STATUS);
+		LCD_WriteGlyph(DOOR_ICON_LINE, DOOR_ICON_POS, LCD_GLYPH_MOVING);
 		MotorStop();
 		MotorBackward();
 		params->m_enter = 0;
@@ -749,24 +978,21 @@ uint8_t doorOpening(state_params_t *params)
 			// door is in error state so it needs to be opened to put the
 			// spool in the correct winding. This means we need to inhibit
 			// the door open switch for a short time to allow it to open.
-			params->m_open_sw_inhibit = RTC_GetSecondTick() + 2;
+			TIMER_Start(params->m_open_sw_inhibit, INHIBIT_ERROR_OPEN_MS, TIMER_ONE_SHOT);
 		}
 		else {
-			params->m_open_sw_inhibit = 0;
+			TIMER_Stop(params->m_open_sw_inhibit);
 		}
 		params->m_door_state = DOOR_STATE_OPENING;
 	}
 
-	if (params->m_open_sw_inhibit != 0 && params->m_open_sw_inhibit > RTC_GetSecondTick()) {
+	if (TIMER_Running(params->m_open_sw_inhibit)) {
 		return ST_DOOR_OPENING;
 	}
-	else {
-		params->m_open_sw_inhibit = 0 ;
-	}
 
-	if ((params->m_key == KEY_DOOR_OPEN) || (params->m_key == KEY_MENU)){
+	if ((params->m_limits & KEY_DOOR_OPEN) || (params->m_key == KEY_MENU)){
 		MotorBrake();
-		if (params->m_key == KEY_DOOR_OPEN) {
+		if (params->m_limits & KEY_DOOR_OPEN) {
 			// only set state to open if open limit switch is hit
 			params->m_door_state = DOOR_STATE_OPEN;
 		}
@@ -789,19 +1015,21 @@ uint8_t doorClosing(state_params_t *params)
 		return ST_IDLE;
 	}
 	if (params->m_enter) {
-		LCD_WriteLine(0, 16, "Door Closing... ");
-		LCD_WriteLine(1, 16, "                ");
+		LCD_WriteLine_P(0, 16, PSTR("Door Closing... "));
+		LCD_WriteLine_P(1, 16, str_blank);
+		LCD_SelectGlyphs(LCD_GLYPH_SET_STATUS);
+		LCD_WriteGlyph(DOOR_ICON_LINE, DOOR_ICON_POS, LCD_GLYPH_MOVING);
 		MotorStop();
 		MotorForward();
 		params->m_enter = 0;
 		params->m_door_state = DOOR_STATE_CLOSING;
 		// we want to inhibit open switch for 5 seconds.
-		params->m_open_sw_inhibit = RTC_GetSecondTick() + 5;
+		TIMER_Start(params->m_open_sw_inhibit, INHIBIT_CLOSE_MS, TIMER_ONE_SHOT);
 	}
 
-	if ((params->m_key == KEY_DOOR_CLOSED) || (params->m_key == KEY_MENU)) {
+	if ((params->m_limits & KEY_DOOR_CLOSED) || (params->m_key == KEY_MENU)) {
 		MotorBrake();
-		if (params->m_key == KEY_DOOR_CLOSED) {
+		if (params->m_limits & KEY_DOOR_CLOSED) {
 			// only set state to closed if door closed limit swith is hit
 			params->m_door_state = DOOR_STATE_CLOSED;
 		}
@@ -811,7 +1039,7 @@ uint8_t doorClosing(state_params_t *params)
 		}
 		return ST_IDLE;
 	}
-	else if (params->m_key == KEY_DOOR_OPEN && params->m_open_sw_inhibit <= RTC_GetSecondTick()) {
+	else if ((params->m_limits & KEY_DOOR_OPEN) && !TIMER_Running(params->m_open_sw_inhibit)) {
 		// this is a special case where the bottom of the door is blocked by dirt and the
 		// motor has fully unwound and starts opening the door again. We need to stop the
 		// motor when it gets to the open switch to stop it buring out.
@@ -828,24 +1056,84 @@ uint8_t doorClosing(state_params_t *params)
 /* ------------------------------------------------------------------ */
 void setDefaultTimes (void)
 {
+#ifndef DS1307_BOARD
 	rtc_time_t times;
+#endif
+	int16_t trim, tzOffset;
+	uint8_t tzRule;
+
+	DS_GetClockTrim(&trim);
+	RTC_SetTrim(trim);
+	/* the clock keeps UTC, the zone gives local time */
+	DS_GetTimezone(&tzOffset, &tzRule);
+	RTC_SetTimezone(tzOffset, tzRule);
 
 #ifdef DS1307_BOARD
 	RTC_SyncTime ();
 #else
+	/* nothing kept time while we were off, 16:00 on 1/1/2000 until
+	 * it's set from the menu */
 	times.m_hour = 16;
 	times.m_min = 0;
 	times.m_sec = 0;
 	RTC_SetTime(&times);
 #endif
+}
+
+/* ------------------------------------------------------------------ */
+/* alarm times from EEP, or from the sun in light mode */
+/* ------------------------------------------------------------------ */
+void loadAlarmTimes (uint8_t doorMode)
+{
+	rtc_time_t open, close;
+	rtc_date_t date;
+	sun_location_t loc;
+
+	if (doorMode == DOOR_MODE_LIGHT) {
+		RTC_GetDate(&date);
+		DS_GetLocation(&loc);
+		if (SUN_GetTimes(RTC_DayOfYear(&date), &loc, RTC_GetUtcOffset(&date), &open, &close)) {
+			RTC_SetOpenTime(&open);
+			RTC_SetCloseTime(&close);
+			return;
+		}
+		/* the sun doesn't rise or set today, use the set times */
+	}
+
+	DS_GetOpenAlarm(&open);
+	RTC_SetOpenTime(&open);
 
-	// Read alarm times from EEP
-	DS_GetOpenAlarm(&times);
-	RTC_SetOpenTime(&times);
+	DS_GetCloseAlarm(&close);
+	RTC_SetCloseTime(&close);
+}
 
-	DS_GetCloseAlarm(&times);
-	RTC_SetCloseTime(&times);
+#ifdef RTC_TIMER2_ASYNC
+/* ------------------------------------------------------------------ *
+ *
+ * Power-save until the next second or a pin change. Not while the
+ * debounce tick or the LCD still need the I/O clock. Interrupts stay
+ * off from the last check to the sleep instruction (sei holds off
+ * interrupts for one more instruction), so a wake up can't slip in
+ * between and be missed.
+ *
+ * ------------------------------------------------------------------ */
+static void powerSave (void)
+{
+	if (LCD_Busy()) {
+		return;
+	}
+	set_sleep_mode(SLEEP_MODE_PWR_SAVE);
+	cli();
+	if (BUTTON_Idle()) {
+		RTC_SleepReady();
+		sleep_enable();
+		sei();
+		sleep_cpu();
+		sleep_disable();
+	}
+	sei();
 }
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
@@ -854,8 +1142,10 @@ int main (void)
 	uint8_t state = ST_IDLE;
 	uint8_t nextstate = ST_IDLE;
 	uint8_t alarm = RTC_ALARM_NONE;
-	uint8_t key = KEY_NONE;
-	uint8_t lastKey = KEY_NONE;
+	key_event_t event;
+#ifndef RTC_TIMER2_ASYNC
+	timer_handle_t heartbeat;
+#endif /* #ifndef RTC_TIMER2_ASYNC */
 	func_p pStateFunc = states[state];
 	state_params_t params;
 
@@ -873,7 +1163,12 @@ int main (void)
 
 	Clear_prescaler();
 	InitLED();
+#ifdef RTC_TIMER2_ASYNC
+	/* the LED draws far more than the sleeping core, leave it off */
+	Led1Off();
+#else
 	Led1On();
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 
 	InitMotor();
 	MotorStop();
@@ -883,80 +1178,119 @@ int main (void)
 	/* initialise I2C Driver */
 	i2c_init ();
 #endif
+	/* the I2C driver is interrupt driven, enable before any transfers */
+	sei();
+
+	/* timebase first, the Timer2 backend tunes the core clock */
+	RTC_Init();
 	LCD_Init();
 	LCD_SetBacklight(1);
 	setDefaultTimes();
-	RTC_Init();
-
-	sei();
+	DS_GetAlarmMode(&params.m_door_mode);
+	loadAlarmTimes(params.m_door_mode);
+#ifdef DS1307_BOARD
+	/* the DS1307 kept time while we were off, put the door where the
+	 * schedule says it should be now */
+	RTC_CatchUpAlarm();
+#endif /* #ifdef DS1307_BOARD */
 
 	/* set params initial state */
 	params.m_enter = 1;
 	params.m_key = KEY_NONE;
+	params.m_repeat = KEY_NONE;
+	params.m_limits = KEY_NONE;
 	params.m_menu_state = 0;
 	params.m_setup_change_state = 0;
 	params.m_door_state = DOOR_STATE_UNKNOWN;
+	RTC_GetSnapshot(&params.m_now);
+	TIMER_Update(params.m_now.m_ms);
+	params.m_menu_timer = TIMER_Create();
+	params.m_open_sw_inhibit = TIMER_Create();
+#ifndef RTC_TIMER2_ASYNC
+	/* not while power saving, the loop sleeps through it */
+	heartbeat = TIMER_Create();
+	TIMER_Start(heartbeat, HEARTBEAT_MS, TIMER_PERIODIC);
+#endif /* #ifndef RTC_TIMER2_ASYNC */
 #ifdef LEONARDO_BOARD
 	params.m_lcdBacklight_timeout = 30;
-	params.m_lcdBacklight_timeout_count = RTC_GetSecondTick() + params.m_lcdBacklight_timeout;
+	params.m_lcdBacklight_timer = TIMER_Create();
+	TIMER_Start(params.m_lcdBacklight_timer, params.m_lcdBacklight_timeout * 1000UL, TIMER_ONE_SHOT);
 #endif /* #ifdef LEONARDO_BOARD */
 #ifdef DS1307_BOARD
 	params.m_lastHour = 24;
-	params.m_lastDay = 8;
 #endif /* #ifdef DS1307_BOARD */
-	DS_GetAlarmMode(&params.m_door_mode);
+	params.m_lastDays = 0xffff;
 
 	while (1)
 	{
-		/* get a key press or limit switch */
-		key = BUTTON_GetKey();
-		if (key != lastKey) {
-			params.m_key = key;
-			/* only allow open/menu/close to be included in last key */
-			if (key == KEY_OPEN || key == KEY_MENU || key == KEY_CLOSE || key == KEY_NONE) {
-				lastKey = key;
-				if (state >= ST_SETUP_MENU && state <= ST_SETUP_MENU_CLOSE_AL) {
-					/* check last key press. if different reset timeout */
-					params.m_menu_timeout = RTC_GetSecondTick() + 20;
-				}
+		/* one look at the clock per pass, everything below works off it */
+		RTC_GetSnapshot(&params.m_now);
+		TIMER_Update(params.m_now.m_ms);
+
+#ifndef RTC_TIMER2_ASYNC
+		/* heartbeat */
+		if (TIMER_Expired(heartbeat)) {
+			Led1Toggle();
+		}
+#endif /* #ifndef RTC_TIMER2_ASYNC */
+
+		/* limit switches are acted on for as long as they are active */
+		params.m_limits = BUTTON_GetKey() & KEY_LIMITS;
+
+		/* key presses and auto-repeat come from the event queue */
+		params.m_key = KEY_NONE;
+		params.m_repeat = KEY_NONE;
+		if (BUTTON_GetEvent(&event)) {
+			if (event.m_type == KEY_EVENT_PRESS) {
+				params.m_key = event.m_key;
+			}
+			else if (event.m_type == KEY_EVENT_REPEAT) {
+				params.m_repeat = event.m_key;
+			}
+			if (state >= ST_SETUP_MENU && state <= ST_SETUP_MENU_CLOSE_AL) {
+				/* any key activity resets the timeout */
+				TIMER_Start(params.m_menu_timer, MENU_TIMEOUT_MS, TIMER_ONE_SHOT);
+			}
 #ifdef LEONARDO_BOARD
-				params.m_lcdBacklight_timeout_count = RTC_GetSecondTick() + params.m_lcdBacklight_timeout;
-				if (LCD_GetBacklight() == 0) {
-					LCD_SetBacklight (1);
-					params.m_key = KEY_NONE;
-				}
-#endif /* #ifdef LEONARDO_BOARD */
+			TIMER_Start(params.m_lcdBacklight_timer, params.m_lcdBacklight_timeout * 1000UL, TIMER_ONE_SHOT);
+			if (LCD_GetBacklight() == 0) {
+				LCD_SetBacklight (1);
+				params.m_key = KEY_NONE;
+				params.m_repeat = KEY_NONE;
 			}
-		}
-		else {
-			/* prevents key from triggering if it is held down */
-			params.m_key = KEY_NONE;
+#endif /* #ifdef LEONARDO_BOARD */
 		}
 
-		/* override key in favour of alarm */
-		alarm = RTC_TestAlarm();
-		if (alarm == RTC_ALARM_OPEN) {
-			params.m_key = KEY_OPEN;
-		}
-		else if ((alarm == RTC_ALARM_CLOSE) && (params.m_door_mode == DOOR_MODE_OPEN_CLOSE)) {
-			params.m_key = KEY_CLOSE;
+		/* override key in favour of alarm. Alarms stay latched in the RTC
+		 * driver while a menu is open or the door is moving. */
+		if ((state == ST_IDLE) || (state == ST_IDLE_ERROR)) {
+			alarm = RTC_TestAlarm();
+			if (alarm == RTC_ALARM_OPEN) {
+				params.m_key = KEY_OPEN;
+			}
+			else if ((alarm == RTC_ALARM_CLOSE) && (params.m_door_mode != DOOR_MODE_OPEN_ONLY)) {
+				params.m_key = KEY_CLOSE;
+			}
 		}
 
 		/* execute the current state function */
 		nextstate = pStateFunc(&params);
 
+		/* send any changed characters to the display */
+		LCD_Flush();
+
 		if (nextstate != state) {
 			pStateFunc = states[nextstate];
 			state = nextstate;
 			params.m_enter = 1;
 			// set timeout for menus
-			params.m_menu_timeout = RTC_GetSecondTick() + 20;
+			TIMER_Start(params.m_menu_timer, MENU_TIMEOUT_MS, TIMER_ONE_SHOT);
 		}
 		else {
 			// no change in state..
 			// check if we are in a menu with no activity.
 			if (state >= ST_SETUP_MENU && state <= ST_SETUP_MENU_CLOSE_AL) {
-				if (params.m_menu_timeout <= RTC_GetSecondTick()) {
+				if (TIMER_Expired(params.m_menu_timer)) {
 					pStateFunc = states[ST_IDLE];
 					state = ST_IDLE;
 					params.m_enter = 1;
@@ -964,11 +1298,17 @@ int main (void)
 			}
 #ifdef LEONARDO_BOARD
 			// backlight turn off
-			if (params.m_lcdBacklight_timeout_count <= RTC_GetSecondTick())
+			if (TIMER_Expired(params.m_lcdBacklight_timer))
 			{
 				LCD_SetBacklight(0);
 			}
 #endif /* #ifdef LEONARDO_BOARD */
+#ifdef RTC_TIMER2_ASYNC
+			// nothing moves until an alarm or a key, sleep till then
+			if ((state == ST_IDLE) || (state == ST_IDLE_ERROR)) {
+				powerSave();
+			}
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 		}
 
 	} /* end of while(1) */
@@ -37,6 +37,16 @@
  * 0x0001 -> Open Alarm Minute
  * 0x0002 -> Close Alarm Hour
  * 0x0003 -> Close Alarm Minute
+ * 0x0004 -> Alarm Mode
+ * 0x0005 -> Clock Trim, ppm (16 bit)
+ * 0x0007 -> Location, sun_location_t (8 bytes)
+ * 0x000F -> Time Zone, standard offset in minutes (16 bit)
+ * 0x0011 -> Time Zone, daylight saving rule
+ *
+ * There is no menu for the location, it is set at build time with
+ * SUN_DEFAULT_LAT/SUN_DEFAULT_LON, or written into the EEPROM image
+ * (lat, lon, open and close offsets, 16 bit little endian each) and
+ * programmed with the chip. A blank location uses the build time one.
  */
 
 #define ADDR_ALARM_OPEN_HOUR	0x00
@@ -44,6 +54,30 @@
 #define ADDR_ALARM_CLOSE_HOUR	0x02
 #define ADDR_ALARM_CLOSE_MIN	0x03
 #define ADDR_ALARM_MODE			0x04
+#define ADDR_CLOCK_TRIM			0x05
+#define ADDR_LOCATION			0x07
+#define ADDR_TZ_OFFSET			0x0F
+#define ADDR_TZ_RULE			0x11
+
+/* used until a location is stored, 1/100 degree */
+#ifndef SUN_DEFAULT_LAT
+#define SUN_DEFAULT_LAT			5150	/* 51.50N */
+#endif
+#ifndef SUN_DEFAULT_LON
+#define SUN_DEFAULT_LON			(-12)	/* 0.12W */
+#endif
+/* hens go in at dusk, give them half an hour after sunset */
+#ifndef SUN_DEFAULT_CLOSE_OFFSET
+#define SUN_DEFAULT_CLOSE_OFFSET	30
+#endif
+/* used until a time zone is stored, minutes east of UTC. No daylight
+ * saving, so the clock keeps the time it was set to as it always has */
+#ifndef TZ_DEFAULT_OFFSET
+#define TZ_DEFAULT_OFFSET		0
+#endif
+#ifndef TZ_DEFAULT_RULE
+#define TZ_DEFAULT_RULE			RTC_TZ_RULE_NONE
+#endif
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void DS_GetOpenAlarm(rtc_time_t *alarm)
@@ -55,8 +89,8 @@ void DS_GetOpenAlarm(rtc_time_t *alarm)
 	if (alarm->m_hour > 23) {
 		alarm->m_hour = 6;
 	}
-	if (alarm->m_hour > 59) {
-		alarm->m_hour = 30;
+	if (alarm->m_min > 59) {
+		alarm->m_min = 30;
 	}
 }
 
@@ -71,8 +105,8 @@ void DS_GetCloseAlarm(rtc_time_t *alarm)
 	if (alarm->m_hour > 23) {
 		alarm->m_hour = 18;
 	}
-	if (alarm->m_hour > 59) {
-		alarm->m_hour = 30;
+	if (alarm->m_min > 59) {
+		alarm->m_min = 30;
 	}
 }
 
@@ -80,12 +114,51 @@ void DS_GetCloseAlarm(rtc_time_t *alarm)
 /* ------------------------------------------------------------------ */
 void DS_GetAlarmMode(uint8_t *mode)
 {
-	*mode = eeprom_read_byte((uint8_t*)ADDR_ALARM_CLOSE_HOUR);
+	*mode = eeprom_read_byte((uint8_t*)ADDR_ALARM_MODE);
 	if (*mode > DOOR_MODE_LIGHT) {
 		*mode = DOOR_MODE_OPEN_CLOSE;
 	}
 }
 
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void DS_GetClockTrim(int16_t *trim)
+{
+	uint16_t raw = eeprom_read_word((uint16_t*)ADDR_CLOCK_TRIM);
+	// blank eeprom, no trim
+	if (raw == 0xffff) {
+		raw = 0;
+	}
+	*trim = (int16_t)raw;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void DS_GetLocation(sun_location_t *loc)
+{
+	eeprom_read_block(loc, (void*)ADDR_LOCATION, sizeof(sun_location_t));
+	// blank eeprom, use the defaults
+	if ((uint16_t)loc->m_lat == 0xffff) {
+		loc->m_lat = SUN_DEFAULT_LAT;
+		loc->m_lon = SUN_DEFAULT_LON;
+		loc->m_open_offset = 0;
+		loc->m_close_offset = SUN_DEFAULT_CLOSE_OFFSET;
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void DS_GetTimezone(int16_t *offset, uint8_t *rule)
+{
+	*rule = eeprom_read_byte((uint8_t*)ADDR_TZ_RULE);
+	// blank (or corrupt) eeprom, use the defaults
+	if (*rule >= RTC_TZ_RULE_MAX) {
+		*offset = TZ_DEFAULT_OFFSET;
+		*rule = TZ_DEFAULT_RULE;
+		return;
+	}
+	*offset = (int16_t)eeprom_read_word((uint16_t*)ADDR_TZ_OFFSET);
+}
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
@@ -110,3 +183,18 @@ void DS_SetAlarmMode(uint8_t mode)
 {
 	eeprom_write_byte((uint8_t*)ADDR_ALARM_MODE, mode);
 }
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void DS_SetClockTrim(int16_t trim)
+{
+	eeprom_update_word((uint16_t*)ADDR_CLOCK_TRIM, (uint16_t)trim);
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void DS_SetTimezone(int16_t offset, uint8_t rule)
+{
+	eeprom_update_word((uint16_t*)ADDR_TZ_OFFSET, (uint16_t)offset);
+	eeprom_update_byte((uint8_t*)ADDR_TZ_RULE, rule);
+}
@@ -24,6 +24,7 @@
 #define _DATA_STORE_H
 
 #include "rtc.h"
+#include "sun-times.h"
 
 enum {
 	DOOR_MODE_NOT_SET = 0,
@@ -35,10 +36,15 @@ enum {
 void DS_GetOpenAlarm(rtc_time_t *alarm);
 void DS_GetCloseAlarm(rtc_time_t *alarm);
 void DS_GetAlarmMode(uint8_t *mode);
+void DS_GetClockTrim(int16_t *trim);
+void DS_GetLocation(sun_location_t *loc);
+void DS_GetTimezone(int16_t *offset, uint8_t *rule);
 
 void DS_SetOpenAlarm(rtc_time_t *alarm);
 void DS_SetCloseAlarm(rtc_time_t *alarm);
 void DS_SetAlarmMode(uint8_t mode);
+void DS_SetClockTrim(int16_t trim);
+void DS_SetTimezone(int16_t offset, uint8_t rule);
 
 #endif /* #ifndef _DATA_STORE_H */
 /* EOF */
@@ -93,6 +93,11 @@
 /** defines the data direction (writing to I2C device) in i2c_start(),i2c_rep_start() */
 #define I2C_WRITE   0
 
+/** return codes of the byte level functions */
+#define I2C_OK           0
+#define I2C_ERR_NACK     1
+#define I2C_ERR_TIMEOUT  2
+
 
 /**
  @brief initialize the I2C master interace. Need to be called only once 
@@ -102,6 +107,25 @@
 extern void i2c_init(void);
 
 
+/**
+ @brief Set the SCL clock used for one device (speed profile)
+ @param  addr    device address, R/W bit ignored
+ @param  scl_hz  SCL clock in Hz
+ @retval 0 profile stored
+ @retval 1 profile table full
+ */
+extern unsigned char i2c_set_speed(unsigned char addr, unsigned long scl_hz);
+
+
+/**
+ @brief Find the fastest clock a device answers at, halving after each NACK
+ @param  addr    device address, R/W bit ignored
+ @param  scl_hz  fastest SCL clock to try in Hz
+ @return clock stored in the device's profile, 0 if the device never answered
+ */
+extern unsigned long i2c_probe(unsigned char addr, unsigned long scl_hz);
+
+
 /** 
  @brief Terminates the data transfer and releases the I2C bus 
  @param void
@@ -114,8 +138,9 @@ extern void i2c_stop(void);
  @brief Issues a start condition and sends address and transfer direction 
   
  @param    addr address and transfer direction of I2C device
- @retval   0   device accessible 
- @retval   1   failed to access device 
+ @retval   I2C_OK           device accessible 
+ @retval   I2C_ERR_NACK     failed to access device 
+ @retval   I2C_ERR_TIMEOUT  bus stuck, it has been recovered
  */
 extern unsigned char i2c_start(unsigned char addr);
 
@@ -124,8 +149,9 @@ extern unsigned char i2c_start(unsigned char addr);
  @brief Issues a repeated start condition and sends address and transfer direction 
 
  @param   addr address and transfer direction of I2C device
- @retval  0 device accessible
- @retval  1 failed to access device
+ @retval  I2C_OK           device accessible
+ @retval  I2C_ERR_NACK     failed to access device
+ @retval  I2C_ERR_TIMEOUT  bus stuck, it has been recovered
  */
 extern unsigned char i2c_rep_start(unsigned char addr);
 
@@ -133,34 +159,51 @@ extern unsigned char i2c_rep_start(unsigned char addr);
 /**
  @brief Issues a start condition and sends address and transfer direction 
    
- If device is busy, use ack polling to wait until device ready 
+ If device is busy, use ack polling to wait until device ready,
+ giving up after a bounded number of attempts
  @param    addr address and transfer direction of I2C device
- @return   none
+ @retval   I2C_OK           device accessible
+ @retval   I2C_ERR_NACK     device still busy
+ @retval   I2C_ERR_TIMEOUT  bus stuck, it has been recovered
  */
-extern void i2c_start_wait(unsigned char addr);
+extern unsigned char i2c_start_wait(unsigned char addr);
 
  
 /**
  @brief Send one byte to I2C device
  @param    data  byte to be transfered
- @retval   0 write successful
- @retval   1 write failed
+ @retval   I2C_OK           write successful
+ @retval   I2C_ERR_NACK     write failed
+ @retval   I2C_ERR_TIMEOUT  bus stuck, it has been recovered
  */
 extern unsigned char i2c_write(unsigned char data);
 
 
 /**
  @brief    read one byte from the I2C device, request more data from device 
- @return   byte read from I2C device
+ @return   byte read from I2C device, 0xff on timeout (see i2c_get_error)
  */
 extern unsigned char i2c_readAck(void);
 
 /**
  @brief    read one byte from the I2C device, read is followed by a stop condition 
- @return   byte read from I2C device
+ @return   byte read from I2C device, 0xff on timeout (see i2c_get_error)
  */
 extern unsigned char i2c_readNak(void);
 
+/**
+ @brief    return and clear the error left by a timed out read or stop
+ @retval   I2C_OK or I2C_ERR_TIMEOUT
+ */
+extern unsigned char i2c_get_error(void);
+
+/**
+ @brief    bus clear: clock SCL until SDA is released, send STOP and
+           re-initialise the TWI. Queued transactions fail with
+           I2C_XFER_TIMEOUT.
+ */
+extern void i2c_recover(void);
+
 /** 
  @brief    read one byte from the I2C device
  
@@ -174,5 +217,64 @@ extern unsigned char i2c_read(unsigned char ack);
 #define i2c_read(ack)  (ack) ? i2c_readAck() : i2c_readNak(); 
 
 
+
+/** transaction status, see i2c_xfer_t */
+#define I2C_XFER_DONE     0
+#define I2C_XFER_PENDING  1
+#define I2C_XFER_ERROR    2
+#define I2C_XFER_TIMEOUT  3
+
+/**
+ @brief  transaction descriptor for the interrupt driven engine
+
+ Writes wlen bytes from wbuf, then (repeated start) reads rlen bytes into
+ rbuf. The descriptor and buffers must stay valid until status is no
+ longer I2C_XFER_PENDING. done, if set, is called from the TWI interrupt.
+ */
+typedef struct i2c_xfer {
+    unsigned char addr;                  /**< device address, R/W bit clear */
+    unsigned char *wbuf;
+    unsigned char wlen;
+    unsigned char *rbuf;
+    unsigned char rlen;
+    volatile unsigned char status;
+    void (*done)(struct i2c_xfer *xfer);
+} i2c_xfer_t;
+
+
+/**
+ @brief    queue a transaction, returns immediately
+ @param    xfer transaction descriptor
+ @retval   0 queued
+ @retval   1 queue full
+ @retval   I2C_ERR_TIMEOUT previous STOP never cleared, bus recovered
+ */
+extern unsigned char i2c_submit(i2c_xfer_t *xfer);
+
+
+/**
+ @brief    queue a transaction, waiting for a free slot if the queue is full
+ @param    xfer transaction descriptor
+ */
+extern void i2c_submit_wait(i2c_xfer_t *xfer);
+
+
+/**
+ @brief    wait for a queued transaction to complete. Recovers the bus if
+           nothing moves on it for I2C_TIMEOUT_US.
+ @param    xfer transaction descriptor
+ @return   I2C_XFER_DONE, I2C_XFER_ERROR or I2C_XFER_TIMEOUT
+ */
+extern unsigned char i2c_wait(i2c_xfer_t *xfer);
+
+
+/**
+ @brief    queue a transaction and wait for it to complete
+ @param    xfer transaction descriptor
+ @return   I2C_XFER_DONE, I2C_XFER_ERROR or I2C_XFER_TIMEOUT
+ */
+extern unsigned char i2c_transfer(i2c_xfer_t *xfer);
+
+
 /**@}*/
 #endif
@@ -28,11 +28,94 @@
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <inttypes.h>
+#include "common.h"
 #include "rtc.h"
 #include "lcd-driver.h"
+#include "lcd-glyphs.h"
 
 const char ascii[10] = "0123456789";
 
+#ifndef LCD_BAUD
+#define LCD_BAUD		9600
+#endif
+
+/* glyph resident in each CGRAM slot, and the selected set */
+static uint8_t lcd_cgram[LCD_CGRAM_SLOTS];
+static uint8_t lcd_glyph_set = LCD_GLYPH_SET_STATUS;
+
+#ifdef LCD_USE_USART
+/* ------------------------------------------------------------------ *
+ *
+ * LCD RX wired to TXD (PD1). Bytes are queued in a ring buffer and
+ * sent by the USART data register empty interrupt, so writing never
+ * masks interrupts or waits for the line (unless the buffer is full).
+ *
+ * ------------------------------------------------------------------ */
+#ifdef LCD_INVERSE_LOGIC
+#error "LCD_INVERSE_LOGIC needs the bit banged driver"
+#endif
+
+#define LCD_UBRR		((F_CPU + (LCD_BAUD * 8UL)) / (LCD_BAUD * 16UL) - 1)
+
+/* must be a power of 2, holds a full two line redraw */
+#define LCD_TXBUF_LEN	64
+#define LCD_TXBUF_MASK	(LCD_TXBUF_LEN - 1)
+
+static volatile uint8_t lcd_txbuf[LCD_TXBUF_LEN];
+static volatile uint8_t lcd_txhead = 0;	/* written by lcd_write */
+static volatile uint8_t lcd_txtail = 0;	/* written by the ISR */
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+#define InitLCD()		do { \
+							UBRR0 = LCD_UBRR; \
+							UCSR0C = (1 << UCSZ01) | (1 << UCSZ00); /* 8N1 */ \
+							UCSR0B = (1 << TXEN0); \
+						} while (0)
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void lcd_write(uint8_t b)
+{
+	uint8_t next = (lcd_txhead + 1) & LCD_TXBUF_MASK;
+
+	/* buffer full, let the ISR drain a byte */
+	while (next == lcd_txtail);
+
+	lcd_txbuf[lcd_txhead] = b;
+	lcd_txhead = next;
+
+	/* the ISR only ever clears UDRIE0, so this RMW can't lose a byte */
+	UCSR0B |= (1 << UDRIE0);
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+ISR(USART_UDRE_vect)
+{
+	uint8_t tail = lcd_txtail;
+
+	if (tail != lcd_txhead) {
+		/* TXC0 is cleared by writing it, the error flags must be 0 */
+		UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0);
+		UDR0 = lcd_txbuf[tail];
+		lcd_txtail = (tail + 1) & LCD_TXBUF_MASK;
+	}
+	else {
+		/* nothing left to send */
+		UCSR0B &= ~(1 << UDRIE0);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* queued, or the last byte still going out */
+/* ------------------------------------------------------------------ */
+uint8_t LCD_Busy(void)
+{
+	return ((lcd_txhead != lcd_txtail) || !(UCSR0A & (1 << TXC0)));
+}
+
+#else /* #ifdef LCD_USE_USART */
 /* ------------------------------------------------------------------ */
 /* LCD PORT/PIN */
 /* ------------------------------------------------------------------ */
@@ -47,16 +130,57 @@ const char ascii[10] = "0123456789";
 #endif
 
 
-/* ------------------------------------------------------------------ */
-/* TX Delay (F_CPU = 16MHz, Baud = 9600) */
-/* ------------------------------------------------------------------ */
-#if F_CPU == 16000000
-const uint16_t lcd_tx_delay = 233;
-const int XMIT_START_ADJUSTMENT = 5;
-#else
-#error "lcd_tx_delay missing!!"
+/* ------------------------------------------------------------------ *
+ * TX Delay
+ *
+ * One pass of lcd_tunedDelay() is 7 cycles (sbiw 2, ldi 1, cpi 1,
+ * cpc 1, brne 2). Each data bit also spends LCD_TX_BIT_OVERHEAD
+ * cycles on the mask loop, pin write and call; the start bit has no
+ * loop around it so it gets the whole bit time in delay passes. At
+ * 16MHz/9600 this gives the original hand tuned 233 and 233 + 5.
+ *
+ * Bit time error (delay * 7 + 36 cycles vs F_CPU / LCD_BAUD):
+ *
+ *   F_CPU    baud   delay  start  error
+ *    8MHz    9600    114    119   +0.08%
+ *    8MHz   19200     54     60   -0.64%
+ *    8MHz   38400     25     30   +1.28%
+ *   12MHz    9600    173    179   -0.24%
+ *   12MHz   19200     84     89   -0.16%
+ *   12MHz   38400     40     45   +1.12%
+ *   16MHz    9600    233    238   +0.02%
+ *   16MHz   19200    114    119   +0.08%
+ *   16MHz   38400     54     60   -0.64%
+ *   20MHz    9600    292    298   -0.16%
+ *   20MHz   19200    144    149   +0.22%
+ *   20MHz   38400     69     74   -0.35%
+ *
+ * Anything over 2% is refused at compile time, the receiver samples
+ * mid bit so that leaves margin for the LCD's own clock.
+ * ------------------------------------------------------------------ */
+#define LCD_TX_LOOP_CYCLES	7
+#define LCD_TX_BIT_OVERHEAD	36
+#define LCD_TX_BIT_CYCLES	((F_CPU + LCD_BAUD / 2) / LCD_BAUD)
+
+#if LCD_TX_BIT_CYCLES < (LCD_TX_BIT_OVERHEAD + LCD_TX_LOOP_CYCLES)
+#error "LCD_BAUD too fast for F_CPU"
+#endif
+
+#define LCD_TX_DELAY		((LCD_TX_BIT_CYCLES - LCD_TX_BIT_OVERHEAD + LCD_TX_LOOP_CYCLES / 2) / LCD_TX_LOOP_CYCLES)
+#define LCD_TX_START_DELAY	((LCD_TX_BIT_CYCLES + LCD_TX_LOOP_CYCLES / 2) / LCD_TX_LOOP_CYCLES)
+#define LCD_TX_ACTUAL_CYCLES	(LCD_TX_DELAY * LCD_TX_LOOP_CYCLES + LCD_TX_BIT_OVERHEAD)
+
+#if LCD_TX_DELAY > 0xfffe
+#error "LCD_BAUD too slow for F_CPU"
 #endif
 
+#if (LCD_TX_ACTUAL_CYCLES * 50 > LCD_TX_BIT_CYCLES * 51) || (LCD_TX_ACTUAL_CYCLES * 50 < LCD_TX_BIT_CYCLES * 49)
+#error "LCD_BAUD can't be matched within 2% at this F_CPU"
+#endif
+
+const uint16_t lcd_tx_delay = LCD_TX_DELAY;
+const uint16_t lcd_tx_start_delay = LCD_TX_START_DELAY;
+
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
@@ -84,7 +208,7 @@ void lcd_write(uint8_t b)
 
 	/* Write the start bit */
 	LcdPinLow();
-	lcd_tunedDelay(lcd_tx_delay + XMIT_START_ADJUSTMENT);
+	lcd_tunedDelay(lcd_tx_start_delay);
 
 	for (uint8_t mask = 0x01; mask; mask <<= 1)	{
 		/* choose bit */
@@ -107,6 +231,46 @@ void lcd_write(uint8_t b)
 	lcd_tunedDelay(lcd_tx_delay);
 }
 
+/* ------------------------------------------------------------------ */
+/* every byte is sent before lcd_write returns */
+/* ------------------------------------------------------------------ */
+uint8_t LCD_Busy(void)
+{
+	return FALSE;
+}
+#endif /* #ifdef LCD_USE_USART */
+
+/* ------------------------------------------------------------------ */
+/* write the CGRAM slots that don't already hold the selected glyphs */
+/* ------------------------------------------------------------------ */
+static void lcd_loadGlyphs(void)
+{
+	uint8_t slot, glyph, row;
+	uint8_t next = LCD_GLYPH_NONE;
+
+	for (slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+		glyph = pgm_read_byte(&lcd_glyph_sets[lcd_glyph_set][slot]);
+		if (glyph == lcd_cgram[slot]) {
+			continue;
+		}
+		if (next != slot) {
+			/* set CGRAM address, the display auto-increments it */
+			lcd_write(0xFE);
+			lcd_write(0x40 | (slot << 3));
+		}
+		for (row = 0; row < LCD_GLYPH_ROWS; row++) {
+			lcd_write(pgm_read_byte(&lcd_glyph_bitmap[glyph][row]));
+		}
+		lcd_cgram[slot] = glyph;
+		next = slot + 1;
+	}
+	if (next != LCD_GLYPH_NONE) {
+		/* back to DDRAM so text doesn't land in CGRAM */
+		lcd_write(0xFE);
+		lcd_write(0x80);
+	}
+}
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void LCD_Init(void)
@@ -116,6 +280,12 @@ void LCD_Init(void)
 	lcd_write(0xFE);
 	lcd_write(0x01);
 	LCD_SetCursor(LCD_CURSOR_OFF);
+
+	/* CGRAM content is unknown at power up */
+	for (uint8_t slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+		lcd_cgram[slot] = LCD_GLYPH_NONE;
+	}
+	lcd_loadGlyphs();
 }
 
 /* ------------------------------------------------------------------ */
@@ -142,6 +312,114 @@ void LCD_WriteLine(uint8_t line, uint8_t len, char *str)
 	}
 }
 
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_WriteLine_P(uint8_t line, uint8_t len, PGM_P str)
+{
+	/* check length is less than 16 */
+	if (len > 16 ) return;
+
+	/* set cursor to line */
+	lcd_write(0xFE);
+	lcd_write(line == 0 ? 0x80 : 0xC0);
+
+	/* stream data straight out of flash */
+	for (uint8_t i = 0; i<len; i++) {
+		lcd_write(pgm_read_byte(str++));
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* 2 row clock across columns 0-14, needs LCD_GLYPH_SET_STATUS */
+/* ------------------------------------------------------------------ */
+void LCD_WriteBigTime(rtc_time_t currentTime)
+{
+	char buf[LCD_BIG_TIME_COLS];
+
+	for (uint8_t row = 0; row < 2; row++) {
+		lcd_bigTimeRow(buf, row, lcd_glyph_set, currentTime);
+		lcd_write(0xFE);
+		lcd_write(row == 0 ? 0x80 : 0xC0);
+		for (uint8_t i = 0; i < LCD_BIG_TIME_COLS; i++) {
+			lcd_write(buf[i]);
+		}
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* nothing is buffered here, so a new set is loaded straight away */
+/* ------------------------------------------------------------------ */
+void LCD_SelectGlyphs(uint8_t set)
+{
+	if ((set < LCD_GLYPH_SET_MAX) && (set != lcd_glyph_set)) {
+		lcd_glyph_set = set;
+		lcd_loadGlyphs();
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_WriteGlyph(uint8_t line, uint8_t pos, uint8_t glyph)
+{
+	if (pos > 15) return;
+
+	lcd_write(0xFE);
+	lcd_write((line == 0 ? 0x80 : 0xC0) + pos);
+	lcd_write(lcd_glyphCode(lcd_glyph_set, glyph));
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_Flush(void)
+{
+	/* nothing buffered, every write goes straight to the display */
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void lcd_writeNumber(uint8_t value)
+{
+	lcd_write(ascii[value / 10]);
+	lcd_write(ascii[value % 10]);
+}
+
+/* three letters per day, Sunday first */
+static const char days[] PROGMEM = "SunMonTueWedThuFriSat";
+
+/* bottom line columns for LCD_CURSOR_DAYNAME .. LCD_CURSOR_YEAR */
+static const uint8_t lcd_date_cursor[4] PROGMEM = {1, 5, 8, 13};
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_WriteDate(rtc_date_t currentDate)
+{
+	PGM_P name = &days[(currentDate.m_dayNumber-1) * 3];
+
+	/* "----------------" */
+	/* " DDD-dd/mm/yyyy " */
+	lcd_write(0xFE);
+	lcd_write(0xC1);
+
+	/* Day Name */
+	for (uint8_t i = 0; i < 3; i++) {
+		lcd_write(pgm_read_byte(name++));
+	}
+	lcd_write('-');
+
+	/* Day */
+	lcd_writeNumber(currentDate.m_day);
+	lcd_write('/');
+
+	/* Month */
+	lcd_writeNumber(currentDate.m_month);
+	lcd_write('/');
+
+	/* Year */
+	lcd_write('2');
+	lcd_write('0');
+	lcd_writeNumber(currentDate.m_year);
+}
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 #ifdef CLOCK_SHOW_SECONDS
@@ -191,6 +469,12 @@ void LCD_SetCursor(uint8_t state)
 		lcd_write(0xFE);
 		lcd_write(0x87);
 	}
+	else if (state >= LCD_CURSOR_DAYNAME) {
+		// set cursor on the date line
+		lcd_write(0x0F);
+		lcd_write(0xFE);
+		lcd_write(0xC0 + pgm_read_byte(&lcd_date_cursor[state - LCD_CURSOR_DAYNAME]));
+	}
 	else /* LCD_CURSOR_OFF */ {
 		// turn cursor off
 		lcd_write(0x0C);
@@ -237,6 +521,12 @@ void LCD_SetCursor(uint8_t state)
 		lcd_write(0xFE);
 		lcd_write(0x88);
 	}
+	else if (state >= LCD_CURSOR_DAYNAME) {
+		// set cursor on the date line
+		lcd_write(0x0F);
+		lcd_write(0xFE);
+		lcd_write(0xC0 + pgm_read_byte(&lcd_date_cursor[state - LCD_CURSOR_DAYNAME]));
+	}
 	else /* LCD_CURSOR_OFF */ {
 		// turn cursor off
 		lcd_write(0x0C);
@@ -25,6 +25,7 @@
 #ifndef _LCD_DRIVER_H
 #define _LCD_DRIVER_H
 
+#include <avr/pgmspace.h>
 #include "rtc.h"
 
 enum {
@@ -37,15 +38,40 @@ enum {
 	LCD_CURSOR_YEAR
 };
 
+/* custom characters, see lcd-glyphs.c */
+enum {
+	LCD_GLYPH_OPEN = 0,
+	LCD_GLYPH_CLOSED,
+	LCD_GLYPH_MOVING,
+	LCD_GLYPH_ERROR,
+	LCD_GLYPH_BAR_TOP,
+	LCD_GLYPH_BAR_BOTTOM,
+	LCD_GLYPH_BAR_BOTH,
+	LCD_GLYPH_COLON,
+	LCD_GLYPH_MAX
+};
+
+/* groups of up to 8 glyphs that are resident in CGRAM together */
+enum {
+	LCD_GLYPH_SET_STATUS = 0,
+	LCD_GLYPH_SET_MAX
+};
+
 void LCD_Init(void);
 void LCD_WriteLine(uint8_t line, uint8_t len, char *str);
+void LCD_WriteLine_P(uint8_t line, uint8_t len, PGM_P str);
+void LCD_Flush(void);
 void LCD_WriteTime(rtc_time_t currentTime);
+void LCD_WriteBigTime(rtc_time_t currentTime);
+void LCD_SelectGlyphs(uint8_t set);
+void LCD_WriteGlyph(uint8_t line, uint8_t pos, uint8_t glyph);
 void LCD_SetCursor(uint8_t state);
 void LCD_Off(void);
 void LCD_SetBacklight(uint8_t onNotOff);
 uint8_t LCD_GetBacklight (void);
-#ifdef DS1307_BOARD
 void LCD_WriteDate(rtc_date_t currentDate);
-#endif /* #ifdef DS1307_BOARD */
+#ifdef POP168_BOARD
+uint8_t LCD_Busy(void);
+#endif /* #ifdef POP168_BOARD */
 
 #endif /* #ifndef _LCD_DRIVER_H */
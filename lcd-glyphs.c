@@ -0,0 +1,136 @@
+/*
+ * Filename		: lcd-glyphs.c
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: HD44780 custom character (CGRAM) tables shared by the
+ *				  LCD drivers.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+#include <avr/pgmspace.h>
+#include <inttypes.h>
+#include "lcd-driver.h"
+#include "lcd-glyphs.h"
+
+/* ------------------------------------------------------------------ */
+/* Bitmaps, must match the LCD_GLYPH_xxx order */
+/* ------------------------------------------------------------------ */
+const uint8_t lcd_glyph_bitmap[LCD_GLYPH_MAX][LCD_GLYPH_ROWS] PROGMEM = {
+	/* LCD_GLYPH_OPEN - empty door frame */
+	{0x1f, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x00},
+	/* LCD_GLYPH_CLOSED - solid door with a handle */
+	{0x1f, 0x1f, 0x1f, 0x1d, 0x1f, 0x1f, 0x1f, 0x00},
+	/* LCD_GLYPH_MOVING - up/down arrows */
+	{0x04, 0x0e, 0x1f, 0x00, 0x1f, 0x0e, 0x04, 0x00},
+	/* LCD_GLYPH_ERROR - inverted '!' */
+	{0x1f, 0x1b, 0x1b, 0x1b, 0x1f, 0x1b, 0x1f, 0x00},
+	/* LCD_GLYPH_BAR_TOP - big digit segments */
+	{0x1f, 0x1f, 0x1f, 0x00, 0x00, 0x00, 0x00, 0x00},
+	/* LCD_GLYPH_BAR_BOTTOM */
+	{0x00, 0x00, 0x00, 0x00, 0x00, 0x1f, 0x1f, 0x1f},
+	/* LCD_GLYPH_BAR_BOTH */
+	{0x1f, 0x1f, 0x1f, 0x00, 0x00, 0x1f, 0x1f, 0x1f},
+	/* LCD_GLYPH_COLON - one dot, used on both rows */
+	{0x00, 0x00, 0x0e, 0x0e, 0x0e, 0x00, 0x00, 0x00},
+};
+
+/* ------------------------------------------------------------------ */
+/* Glyph sets, must match the LCD_GLYPH_SET_xxx order. Slots that keep
+ * the same glyph across sets are not reloaded when the set changes. */
+/* ------------------------------------------------------------------ */
+const uint8_t lcd_glyph_sets[LCD_GLYPH_SET_MAX][LCD_CGRAM_SLOTS] PROGMEM = {
+	/* LCD_GLYPH_SET_STATUS - door icons and the big clock */
+	{LCD_GLYPH_OPEN, LCD_GLYPH_CLOSED, LCD_GLYPH_MOVING, LCD_GLYPH_ERROR,
+	 LCD_GLYPH_BAR_TOP, LCD_GLYPH_BAR_BOTTOM, LCD_GLYPH_BAR_BOTH,
+	 LCD_GLYPH_COLON},
+};
+
+/* ------------------------------------------------------------------ *
+ *
+ * Big digits are 3 columns by 2 rows built from the bar segments and
+ * the controller's own full block (0xff).
+ *
+ * ------------------------------------------------------------------ */
+#define BT		LCD_GLYPH_BAR_TOP
+#define BB		LCD_GLYPH_BAR_BOTTOM
+#define BM		LCD_GLYPH_BAR_BOTH
+#define FB		0xff
+#define SP		' '
+
+static const uint8_t lcd_big_digit[10][2][3] PROGMEM = {
+	{{FB, BT, FB}, {FB, BB, FB}},	/* 0 */
+	{{BT, FB, SP}, {BB, FB, BB}},	/* 1 */
+	{{BM, BM, FB}, {FB, BB, BB}},	/* 2 */
+	{{BT, BM, FB}, {BB, BB, FB}},	/* 3 */
+	{{FB, BB, FB}, {SP, SP, FB}},	/* 4 */
+	{{FB, BM, BM}, {BB, BB, FB}},	/* 5 */
+	{{FB, BM, BM}, {FB, BB, FB}},	/* 6 */
+	{{BT, BT, FB}, {SP, SP, FB}},	/* 7 */
+	{{FB, BM, FB}, {FB, BB, FB}},	/* 8 */
+	{{FB, BM, FB}, {BB, BB, FB}},	/* 9 */
+};
+
+/* ------------------------------------------------------------------ */
+/* character code that shows glyph with the given set loaded */
+/* ------------------------------------------------------------------ */
+uint8_t lcd_glyphCode(uint8_t set, uint8_t glyph)
+{
+	uint8_t slot;
+
+	for (slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+		if (pgm_read_byte(&lcd_glyph_sets[set][slot]) == glyph) {
+			return slot;
+		}
+	}
+	/* not in this set, leave the cell blank */
+	return ' ';
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static char *lcd_bigDigit(char *buf, uint8_t row, uint8_t set, uint8_t digit)
+{
+	uint8_t col, c;
+
+	for (col = 0; col < 3; col++) {
+		c = pgm_read_byte(&lcd_big_digit[digit][row][col]);
+		if (c < LCD_GLYPH_MAX) {
+			c = lcd_glyphCode (set, c);
+		}
+		*buf++ = c;
+	}
+	return buf;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Fill buf with one row of the big clock, LCD_BIG_TIME_COLS cells:
+ * "HHH HHH:MMM MMM"
+ *
+ * ------------------------------------------------------------------ */
+void lcd_bigTimeRow(char *buf, uint8_t row, uint8_t set, rtc_time_t currentTime)
+{
+	buf = lcd_bigDigit (buf, row, set, currentTime.m_hour / 10);
+	*buf++ = ' ';
+	buf = lcd_bigDigit (buf, row, set, currentTime.m_hour % 10);
+	*buf++ = lcd_glyphCode (set, LCD_GLYPH_COLON);
+	buf = lcd_bigDigit (buf, row, set, currentTime.m_min / 10);
+	*buf++ = ' ';
+	lcd_bigDigit (buf, row, set, currentTime.m_min % 10);
+}
+
+/* EOF */
@@ -0,0 +1,50 @@
+/*
+ * Filename		: lcd-glyphs.h
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: HD44780 custom character (CGRAM) tables shared by the
+ *				  LCD drivers.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+#ifndef _LCD_GLYPHS_H
+#define _LCD_GLYPHS_H
+
+#include <inttypes.h>
+#include <avr/pgmspace.h>
+#include "rtc.h"
+
+/* HD44780 has room for 8 5x8 custom characters, codes 0-7 */
+#define LCD_CGRAM_SLOTS			8
+#define LCD_GLYPH_ROWS			8
+
+/* slot contents unknown (after power up or a failed transfer) */
+#define LCD_GLYPH_NONE			0xff
+
+/* big clock is HH:MM, 3 columns per digit plus gaps and colon */
+#define LCD_BIG_TIME_COLS		15
+
+/* 5x8 bitmap for each LCD_GLYPH_xxx, one byte per pixel row */
+extern const uint8_t lcd_glyph_bitmap[][LCD_GLYPH_ROWS] PROGMEM;
+
+/* glyph held by each CGRAM slot in a glyph set */
+extern const uint8_t lcd_glyph_sets[][LCD_CGRAM_SLOTS] PROGMEM;
+
+uint8_t lcd_glyphCode(uint8_t set, uint8_t glyph);
+void lcd_bigTimeRow(char *buf, uint8_t row, uint8_t set, rtc_time_t currentTime);
+
+#endif /* #ifndef _LCD_GLYPHS_H */
@@ -23,7 +23,9 @@
 #include <util/delay.h>
 #include "i2cmaster.h"
 #include "lcd-driver.h"
+#include "lcd-glyphs.h"
 #include "rtc.h"
+#include "common.h"
 
 /* ------------------------------------------------------------------ *
  *
@@ -61,6 +63,7 @@
 #define CMD_DISPLAY_CONTROL			0x08
 #define CMD_CURSOR_DISPLAY_SHIFT	0x10
 #define CMD_FUNCTION_SET			0x20
+#define CMD_CGRAM_SET				0x40
 #define CMD_DDRAM_SET				0x80
 
 /* ------------------------------------------------------------------ */
@@ -75,6 +78,39 @@
 #define OPT_SHIFT_RIGHT				0x04	// CMD_CURSOR_DISPLAY_SHIFT 0 = Left
 #define OPT_2_LINES					0x08	// CMD_FUNCTION_SET 0 = 1 line
 #define OPT_5X10_DOTS				0x04	// CMD_FUNCTION_SET 0 = 5x7 dots
+
+/* ------------------------------------------------------------------ */
+/* Execution times (us, worst case from the HD44780 datasheet) */
+/* ------------------------------------------------------------------ */
+/* indexed by the highest set bit of the command byte */
+static const uint16_t lcd_cmd_delay[8] PROGMEM = {
+	1640,	// CMD_CLEAR_DISPLAY
+	1640,	// CMD_RETURN_HOME
+	37,		// CMD_ENTRY_MODE
+	37,		// CMD_DISPLAY_CONTROL
+	37,		// CMD_CURSOR_DISPLAY_SHIFT
+	37,		// CMD_FUNCTION_SET
+	37,		// CMD_CGRAM_SET
+	37		// CMD_DDRAM_SET
+};
+#define LCD_DATA_DELAY				41		// 37us + tADD
+
+/* fastest SCL the PCF8574 is rated for, LCD_Init probes down from here */
+#define LCD_SCL_CLOCK				400000L
+
+/* The next nibble needs at least two bytes on the bus before E falls
+ * again. At SCL <= 400kHz that is >= 45us, which already covers every
+ * instruction except clear and home. */
+#define LCD_BUS_GAP_US				45
+
+/* poll the busy flag (D7 via RW) instead of sleeping for slow commands */
+#define LCD_USE_BUSY_FLAG
+#define LCD_BUSY_POLL_MAX			16
+#define LCD_BUSY_ERROR				2
+
+/* flushes skipped behind a transfer that is still pending before
+ * LCD_Flush waits on it, which recovers a stuck bus */
+#define LCD_FLUSH_SKIP_MAX			32
 	
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
@@ -84,33 +120,221 @@ enum
 	DATA
 };
 
+/* ------------------------------------------------------------------ */
+/* Display geometry (override with -DLCD_ROWS=4 -DLCD_COLS=20) */
+/* ------------------------------------------------------------------ */
+#ifndef LCD_ROWS
+#define LCD_ROWS					2
+#endif
+#ifndef LCD_COLS
+#define LCD_COLS					16
+#endif
+
+/* a run of unchanged cells this short is cheaper to resend than to
+ * skip with a DDRAM address command (both cost one byte on the bus) */
+#define LCD_GAP_BRIDGE				1
+
+#define LCD_ADDR_UNKNOWN			0xff
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint8_t devAddr = 0x4e;
 uint8_t backlight = 0;
 const char ascii[10] = "0123456789";
+const uint8_t lcd_row_addr[4] = {0x00, 0x40, 0x14, 0x54};
+
+/* frame = what we want on screen, ddram = what the display is showing */
+static char lcd_frame[LCD_ROWS][LCD_COLS];
+static char lcd_ddram[LCD_ROWS][LCD_COLS];
+static uint8_t lcd_addr = LCD_ADDR_UNKNOWN;
+static uint8_t lcd_cursor = LCD_ADDR_UNKNOWN;
+static uint8_t lcd_port = 0;	/* last byte latched by the PCF8574 */
+static uint8_t lcd_session = 0;	/* nesting depth of open I2C writes */
+
+/* port bytes are collected here and handed to the TWI engine in one
+ * transaction; a 2x16 frame update fits without splitting */
+#define LCD_TXBUF_LEN				160
+static uint8_t lcd_txbuf[LCD_TXBUF_LEN];
+static uint8_t lcd_txlen = 0;
+static i2c_xfer_t lcd_xfer;
+static uint8_t lcd_fault = 0;	/* a transfer failed, display needs a reset */
+static uint8_t lcd_stall = 0;	/* flushes skipped while the bus was busy */
+
+/* glyph resident in each CGRAM slot, and the set the screen wants */
+static uint8_t lcd_cgram[LCD_CGRAM_SLOTS];
+static uint8_t lcd_glyph_set = LCD_GLYPH_SET_STATUS;
+static uint8_t lcd_glyph_dirty = 0;
 
 /* ------------------------------------------------------------------ */
+/* queue the buffered port bytes (and an optional read) */
 /* ------------------------------------------------------------------ */
-static void lcd_write_ioex (uint8_t data)
+static void lcd_send (uint8_t *rbuf, uint8_t rlen)
+{
+	lcd_xfer.addr = devAddr;
+	lcd_xfer.wbuf = lcd_txbuf;
+	lcd_xfer.wlen = lcd_txlen;
+	lcd_xfer.rbuf = rbuf;
+	lcd_xfer.rlen = rlen;
+	lcd_xfer.done = NULL;
+	i2c_submit_wait (&lcd_xfer);
+}
+
+/* ------------------------------------------------------------------ */
+/* wait for the last queued transaction so the buffer can be reused */
+/* ------------------------------------------------------------------ */
+static uint8_t lcd_sync (void)
+{
+	uint8_t status = i2c_wait (&lcd_xfer);
+	if (status != I2C_XFER_DONE) {
+		/* a nibble may have been lost, 4bit sync can't be trusted */
+		lcd_fault = 1;
+	}
+	lcd_txlen = 0;
+	return status;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void lcd_emit (uint8_t data)
+{
+	if (lcd_txlen == LCD_TXBUF_LEN) {
+		lcd_send (NULL, 0);
+		lcd_sync ();
+	}
+	lcd_txbuf[lcd_txlen++] = data;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * The PCF8574 latches every data byte of a write transaction onto its
+ * port, so a whole run of port updates can share one start/address/stop.
+ * Sessions nest; the outermost lcd_end() queues the transaction and
+ * returns without waiting for the bus.
+ *
+ * ------------------------------------------------------------------ */
+static void lcd_begin (void)
 {
-	i2c_start (devAddr);
-	i2c_write (data);
-	i2c_stop ();
+	if (lcd_session++ == 0) {
+		lcd_sync ();
+	}
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
+static void lcd_end (void)
+{
+	if ((--lcd_session == 0) && lcd_txlen) {
+		lcd_send (NULL, 0);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void lcd_write_ioex (uint8_t data)
+{
+	lcd_begin ();
+	lcd_emit (data);
+	lcd_port = data;
+	lcd_end ();
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Clock one nibble into the HD44780. It latches on the falling edge
+ * of E, so the data can ride along with the rising edge. A separate
+ * setup byte is only needed when RS/RW/BL change, as RS and RW must
+ * settle before E goes high.
+ *
+ * ------------------------------------------------------------------ */
 static void lcd_strobe (uint8_t byte)
 {
 	uint8_t data = byte;
 	if (backlight) {
 		data |= (1 << BL);
 	}
-	
-	lcd_write_ioex (data);
-	lcd_write_ioex (data | (1 << EN));
-	_delay_ms(2);
+
+	lcd_begin ();
+	if ((lcd_port ^ data) & ((1 << RS) | (1 << RW) | (1 << BL))) {
+		lcd_emit (data);
+	}
+	lcd_emit (data | (1 << EN));
+	lcd_emit (data);
+	lcd_port = data;
+	lcd_end ();
+}
+
+#ifdef LCD_USE_BUSY_FLAG
+/* ------------------------------------------------------------------ *
+ *
+ * Read the busy flag. D4-D7 are driven high so the PCF8574 releases
+ * them (quasi-bidirectional), then the port is read back with E high.
+ * Both nibbles must be clocked even though only D7 of the first is
+ * used. This has to wait for the bus, so only slow commands use it.
+ *
+ * ------------------------------------------------------------------ */
+static uint8_t lcd_busy (void)
+{
+	uint8_t port = 0xf0 | (1 << RW);
+	uint8_t status = 0;
+	uint8_t busy;
+
+	if (backlight) {
+		port |= (1 << BL);
+	}
+
+	lcd_begin ();
+	lcd_emit (port);
+	lcd_emit (port | (1 << EN));
+	lcd_send (&status, 1);
+	if (lcd_sync () == I2C_XFER_DONE) {
+		busy = (status >> D7) & 1;
+	}
+	else {
+		busy = LCD_BUSY_ERROR;
+	}
+	lcd_emit (port);
+	lcd_emit (port | (1 << EN));
+	lcd_emit (port);
+	lcd_port = port;
+	lcd_end ();
+
+	return busy;
+}
+#endif /* #ifdef LCD_USE_BUSY_FLAG */
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void lcd_wait (uint16_t us)
+{
+#ifdef LCD_USE_BUSY_FLAG
+	uint8_t poll, busy;
+#endif
+
+	if (us <= LCD_BUS_GAP_US) {
+		/* the bus is slower than the display */
+		return;
+	}
+#ifdef LCD_USE_BUSY_FLAG
+	for (poll = 0; poll < LCD_BUSY_POLL_MAX; poll++) {
+		busy = lcd_busy ();
+		if (busy == 0) {
+			return;
+		}
+		if (busy == LCD_BUSY_ERROR) {
+			break;
+		}
+	}
+#endif
+	/* no usable busy flag, sleep the worst case once the bytes are out */
+	if (lcd_txlen) {
+		lcd_send (NULL, 0);
+	}
+	lcd_sync ();
+	while (us > 10) {
+		_delay_us(10);
+		us -= 10;
+	}
+	_delay_us(10);
 }
 
 /* ------------------------------------------------------------------ *
@@ -123,68 +347,276 @@ static void lcd_command (uint8_t byte, uint8_t mode)
 {
 	uint8_t port_bytes[2];
 	uint8_t nibble;
+	uint8_t index;
 	
 	port_bytes[0] = (byte & 0xf0);
 	port_bytes[1] = ((byte << 4) & 0xf0);
+	lcd_begin ();
 	for (nibble = 0; nibble < 2; nibble++) {
 		if (mode == DATA) {
 			port_bytes[nibble] |= (1 << RS);
 		}
 		// strobe E
 		lcd_strobe (port_bytes[nibble]);
-	}  
+	}
+
+	if (mode == DATA) {
+		lcd_wait (LCD_DATA_DELAY);
+	}
+	else {
+		for (index = 7; index > 0 && !(byte & (1 << index)); index--);
+		lcd_wait (pgm_read_word(&lcd_cmd_delay[index]));
+	}
+	lcd_end ();
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
-static void lcd_setPosition(uint8_t line, uint8_t pos)
+static void lcd_setAddress(uint8_t address)
 {
-	uint8_t address = 0;
-	if (line == 1)
-		address = pos;
-	else if (line == 2)
-		address = 0x40 + pos;
-	else if (line == 3)
-		address = 0x14 + pos;
-	else if (line == 4)
-		address = 0x54 + pos;
 	lcd_command (CMD_DDRAM_SET + address, COMMAND);
+	lcd_addr = address;
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
-void LCD_Init(void)
+static void lcd_setPosition(uint8_t line, uint8_t pos)
+{
+	lcd_setAddress (lcd_row_addr[line-1] + pos);
+}
+
+/* ------------------------------------------------------------------ */
+/* write a single cell from the frame buffer at the current address   */
+/* ------------------------------------------------------------------ */
+static void lcd_putCell(uint8_t row, uint8_t col)
+{
+	lcd_command (lcd_frame[row][col], DATA);
+	lcd_ddram[row][col] = lcd_frame[row][col];
+	lcd_addr++;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void lcd_putString(uint8_t row, uint8_t col, const char *str, uint8_t len)
+{
+	if (row >= LCD_ROWS) return;
+	while (len-- && col < LCD_COLS) {
+		lcd_frame[row][col++] = *str++;
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* as lcd_putString, reading the text from flash                      */
+/* ------------------------------------------------------------------ */
+static void lcd_putString_P(uint8_t row, uint8_t col, PGM_P str, uint8_t len)
+{
+	if (row >= LCD_ROWS) return;
+	while (len-- && col < LCD_COLS) {
+		lcd_frame[row][col++] = pgm_read_byte(str++);
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void lcd_putNumber(uint8_t row, uint8_t col, uint8_t value)
+{
+	char digits[2];
+	digits[0] = ascii[value / 10];
+	digits[1] = ascii[value % 10];
+	lcd_putString (row, col, digits, 2);
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Bring CGRAM in line with the selected glyph set. Only slots holding
+ * a different glyph are written and consecutive slots share one
+ * address command. Leaves the address counter in CGRAM, so the caller
+ * must be inside a session and set a DDRAM address afterwards.
+ *
+ * ------------------------------------------------------------------ */
+static void lcd_loadGlyphs(void)
+{
+	uint8_t slot, glyph, row;
+	uint8_t next = LCD_GLYPH_NONE;	/* slot the CGRAM address points at */
+
+	for (slot = 0; slot < LCD_CGRAM_SLOTS; slot++) {
+		glyph = pgm_read_byte(&lcd_glyph_sets[lcd_glyph_set][slot]);
+		if (glyph == lcd_cgram[slot]) {
+			continue;
+		}
+		if (next != slot) {
+			lcd_command (CMD_CGRAM_SET | (slot << 3), COMMAND);
+		}
+		for (row = 0; row < LCD_GLYPH_ROWS; row++) {
+			lcd_command (pgm_read_byte(&lcd_glyph_bitmap[glyph][row]), DATA);
+		}
+		lcd_cgram[slot] = glyph;
+		next = slot + 1;
+	}
+	lcd_addr = LCD_ADDR_UNKNOWN;
+	lcd_glyph_dirty = 0;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Put the controller through its 4bit init sequence and clear it. Used
+ * at start up and again whenever a transfer failed, as a lost nibble
+ * leaves the display out of step.
+ *
+ * ------------------------------------------------------------------ */
+static void lcd_reset(void)
 {
 	uint8_t initialize_i2c_data = 0;
+	uint8_t row, col;
+
+	lcd_fault = 0;
 
 	// Set initial values to 0
 	lcd_write_ioex (0);
 	
-	// Activate LCD
+	// Activate LCD (busy flag can't be read until 4bit mode is set)
 	initialize_i2c_data = (1 << D4) | (1 << D5);
 	lcd_strobe (initialize_i2c_data);
+	lcd_sync ();
+	_delay_ms(5);
 	lcd_strobe (initialize_i2c_data);
+	lcd_sync ();
+	_delay_us(150);
 	lcd_strobe (initialize_i2c_data);
+	lcd_sync ();
+	_delay_us(150);
 
 	// initialise LCD for 4bit mode
 	initialize_i2c_data &= ~(1 << D4);
 	lcd_strobe (initialize_i2c_data);
+	lcd_sync ();
+	_delay_us(150);
 	
 	// set two line
 	lcd_command (CMD_FUNCTION_SET | OPT_2_LINES, COMMAND);
 	lcd_command (CMD_DISPLAY_CONTROL | OPT_ENABLE_DISPLAY, COMMAND);
 	lcd_command (CMD_CLEAR_DISPLAY, COMMAND);
 	lcd_command (CMD_ENTRY_MODE | OPT_INCREMENT, COMMAND);
+
+	// clear display fills DDRAM with spaces and homes the address
+	for (row = 0; row < LCD_ROWS; row++) {
+		for (col = 0; col < LCD_COLS; col++) {
+			lcd_ddram[row][col] = ' ';
+		}
+	}
+	lcd_addr = 0;
+	lcd_cursor = LCD_ADDR_UNKNOWN;
+
+	// CGRAM may hold a half written glyph, reload them all
+	for (col = 0; col < LCD_CGRAM_SLOTS; col++) {
+		lcd_cgram[col] = LCD_GLYPH_NONE;
+	}
+	lcd_glyph_dirty = 1;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_Init(void)
+{
+	uint8_t row, col;
+
+	// run the backpack as fast as it will answer
+	i2c_probe (devAddr, LCD_SCL_CLOCK);
+
+	for (row = 0; row < LCD_ROWS; row++) {
+		for (col = 0; col < LCD_COLS; col++) {
+			lcd_frame[row][col] = ' ';
+		}
+	}
+	lcd_reset ();
+
+	// frame matches the cleared display, this only loads the glyphs
+	LCD_Flush ();
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void LCD_WriteLine(uint8_t line, uint8_t len, char *str)
 {
-	uint8_t loop = 0;
-	lcd_setPosition (line+1, 0);
-	for (loop=0; loop<len; loop++) {
-		lcd_command (str[loop], DATA);
+	lcd_putString (line, 0, str, len);
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_WriteLine_P(uint8_t line, uint8_t len, PGM_P str)
+{
+	lcd_putString_P (line, 0, str, len);
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Send only the cells that differ between the frame buffer and what
+ * the display holds. The HD44780 auto-increments its address, so a
+ * DDRAM set is only needed when a run of unchanged cells is skipped.
+ *
+ * ------------------------------------------------------------------ */
+void LCD_Flush(void)
+{
+	uint8_t row, col, c;
+	uint8_t address;
+	uint8_t written = 0;
+
+	/* previous update still on the bus, try again next time round */
+	if (lcd_xfer.status == I2C_XFER_PENDING) {
+		if (++lcd_stall < LCD_FLUSH_SKIP_MAX) {
+			return;
+		}
+		lcd_sync ();
+	}
+	lcd_stall = 0;
+
+	/* last update failed, bring the display back and redraw it all */
+	if (lcd_fault || (lcd_xfer.status != I2C_XFER_DONE)) {
+		lcd_reset ();
+	}
+
+	/* glyphs first, so cells drawn below already show the new set */
+	if (lcd_glyph_dirty) {
+		lcd_begin ();
+		written = 1;
+		lcd_loadGlyphs ();
+	}
+
+	for (row = 0; row < LCD_ROWS; row++) {
+		for (col = 0; col < LCD_COLS; col++) {
+			if (lcd_frame[row][col] == lcd_ddram[row][col]) {
+				continue;
+			}
+			if (!written) {
+				/* the whole update goes out in a single I2C session */
+				lcd_begin ();
+				written = 1;
+			}
+			address = lcd_row_addr[row] + col;
+			if (lcd_addr != address) {
+				if ((lcd_addr != LCD_ADDR_UNKNOWN) &&
+						(lcd_addr >= lcd_row_addr[row]) &&
+						(lcd_addr < address) &&
+						((address - lcd_addr) <= LCD_GAP_BRIDGE)) {
+					/* cheaper to resend the unchanged cells */
+					for (c = lcd_addr - lcd_row_addr[row]; c < col; c++) {
+						lcd_putCell (row, c);
+					}
+				}
+				else {
+					lcd_setAddress (address);
+				}
+			}
+			lcd_putCell (row, col);
+		}
+	}
+
+	if (written) {
+		/* put a visible cursor back where it was */
+		if (lcd_cursor != LCD_ADDR_UNKNOWN) {
+			lcd_setAddress (lcd_cursor);
+		}
+		lcd_end ();
 	}
 }
 
@@ -211,103 +643,74 @@ uint8_t LCD_GetBacklight (void)
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 #ifdef CLOCK_SHOW_SECONDS
+#define LCD_TIME_POS	4
+#else
+#define LCD_TIME_POS	5
+#endif
+
 void LCD_WriteTime(rtc_time_t currentTime)
 {
-	uint8_t n1, n2;
-	lcd_setPosition (1, 4);
-	
+	// -----xx:xx------ / ----xx:xx:xx----
 	// Hour
-	n1 = (currentTime.m_hour / 10);
-	n2 = (currentTime.m_hour % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-	lcd_command (':', DATA);
+	lcd_putNumber (0, LCD_TIME_POS, currentTime.m_hour);
+	lcd_putString (0, LCD_TIME_POS + 2, ":", 1);
 
 	// Minute
-	n1 = (currentTime.m_min / 10);
-	n2 = (currentTime.m_min % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-	lcd_command (':', DATA);
+	lcd_putNumber (0, LCD_TIME_POS + 3, currentTime.m_min);
+#ifdef CLOCK_SHOW_SECONDS
+	lcd_putString (0, LCD_TIME_POS + 5, ":", 1);
 
 	// Second
-	n1 = (currentTime.m_sec / 10);
-	n2 = (currentTime.m_sec % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-	
-	lcd_command (CMD_RETURN_HOME, COMMAND); // return home
+	lcd_putNumber (0, LCD_TIME_POS + 6, currentTime.m_sec);
+#endif
 }
+
 /* ------------------------------------------------------------------ */
+/* 2 row clock across columns 0-14, needs LCD_GLYPH_SET_STATUS */
 /* ------------------------------------------------------------------ */
-void LCD_SetCursor(uint8_t state)
+void LCD_WriteBigTime(rtc_time_t currentTime)
 {
-	if (state == LCD_CURSOR_OFF) {
-		// turn cursor off
-		lcd_command (CMD_DISPLAY_CONTROL, COMMAND);
-		lcd_command (CMD_DISPLAY_CONTROL | OPT_ENABLE_DISPLAY, COMMAND);
-	}
-	else {
-		switch (state) {
-			case LCD_CURSOR_HOUR:
-				// set cursor to hour
-				lcd_setPosition (1, 5);
-				break;
-			case LCD_CURSOR_MIN:
-				// set cursot to minute
-				lcd_setPosition (1, 8);
-				break;
-			case LCD_CURSOR_DAYNAME:
-				// set cursot to day name
-				lcd_setPosition (2, 1);
-				break;
-			case LCD_CURSOR_DAY:
-				// set cursot to day
-				lcd_setPosition (2, 6);
-				break;
-			case LCD_CURSOR_MONTH:
-				// set cursot to month
-				lcd_setPosition (2, 9);
-				break;
-			case LCD_CURSOR_YEAR:
-				// set cursot to year
-				lcd_setPosition (2, 14);
-				break;
-		}
-		lcd_command (CMD_DISPLAY_CONTROL
-					| OPT_ENABLE_DISPLAY
-					| OPT_ENABLE_CURSOR
-					| OPT_ENABLE_BLINK, COMMAND);
+	char buf[LCD_BIG_TIME_COLS];
+	uint8_t row;
+
+	for (row = 0; row < 2; row++) {
+		lcd_bigTimeRow (buf, row, lcd_glyph_set, currentTime);
+		lcd_putString (row, 0, buf, LCD_BIG_TIME_COLS);
 	}
 }
-#else
-void LCD_WriteTime(rtc_time_t currentTime)
-{
-	uint8_t n1, n2;
-	lcd_setPosition (1, 5);
 
-	// -----xx:xx------
-	// Hour
-	n1 = (currentTime.m_hour / 10);
-	n2 = (currentTime.m_hour % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-	lcd_command (':', DATA);
-
-	// Minute
-	n1 = (currentTime.m_min / 10);
-	n2 = (currentTime.m_min % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
+/* ------------------------------------------------------------------ *
+ *
+ * Pick the glyph set for the next screen. CGRAM is only written by
+ * the next LCD_Flush, and then only the slots that differ.
+ *
+ * ------------------------------------------------------------------ */
+void LCD_SelectGlyphs(uint8_t set)
+{
+	if ((set < LCD_GLYPH_SET_MAX) && (set != lcd_glyph_set)) {
+		lcd_glyph_set = set;
+		lcd_glyph_dirty = 1;
+	}
+}
 
-	lcd_command (CMD_RETURN_HOME, COMMAND); // return home
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void LCD_WriteGlyph(uint8_t line, uint8_t pos, uint8_t glyph)
+{
+	if ((line >= LCD_ROWS) || (pos >= LCD_COLS)) return;
+	lcd_frame[line][pos] = lcd_glyphCode (lcd_glyph_set, glyph);
 }
+
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void LCD_SetCursor(uint8_t state)
 {
+	/* pending cells must go out before the address is moved */
+	LCD_Flush ();
+
 	if (state == LCD_CURSOR_OFF) {
 		// turn cursor off
+		lcd_cursor = LCD_ADDR_UNKNOWN;
 		lcd_command (CMD_DISPLAY_CONTROL, COMMAND);
 		lcd_command (CMD_DISPLAY_CONTROL | OPT_ENABLE_DISPLAY, COMMAND);
 	}
@@ -315,11 +718,11 @@ void LCD_SetCursor(uint8_t state)
 		switch (state) {
 			case LCD_CURSOR_HOUR:
 				// set cursor to hour
-				lcd_setPosition (1, 6);
+				lcd_setPosition (1, LCD_TIME_POS + 1);
 				break;
 			case LCD_CURSOR_MIN:
 				// set cursot to minute
-				lcd_setPosition (1, 9);
+				lcd_setPosition (1, LCD_TIME_POS + 4);
 				break;
 			case LCD_CURSOR_DAYNAME:
 				// set cursot to day name
@@ -338,58 +741,41 @@ void LCD_SetCursor(uint8_t state)
 				lcd_setPosition (2, 14);
 				break;
 		}
+		lcd_cursor = lcd_addr;
 		lcd_command (CMD_DISPLAY_CONTROL
 					| OPT_ENABLE_DISPLAY
 					| OPT_ENABLE_CURSOR
 					| OPT_ENABLE_BLINK, COMMAND);
 	}
 }
-#endif
 
-#ifdef DS1307_BOARD
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
-const char *days[7] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+/* three letters per day, Sunday first */
+static const char days[] PROGMEM = "SunMonTueWedThuFriSat";
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void LCD_WriteDate(rtc_date_t currentDate)
 {
-	uint8_t n1, n2;
 	/* "----------------" */
 	/* " DDD-dd/mm/yyyy " */
-	lcd_setPosition (2, 1);
 
 	/* Day Name */
-	lcd_command (days[currentDate.m_dayNumber-1][0], DATA);
-	lcd_command (days[currentDate.m_dayNumber-1][1], DATA);
-	lcd_command (days[currentDate.m_dayNumber-1][2], DATA);
-	lcd_command ('-', DATA);
+	lcd_putString_P (1, 1, &days[(currentDate.m_dayNumber-1) * 3], 3);
+	lcd_putString_P (1, 4, PSTR("-"), 1);
 	
 	/* Day */
-	n1 = (currentDate.m_day / 10);
-	n2 = (currentDate.m_day % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-	lcd_command ('/', DATA);
+	lcd_putNumber (1, 5, currentDate.m_day);
+	lcd_putString_P (1, 7, PSTR("/"), 1);
 	
 	/* Month */
-	n1 = (currentDate.m_month / 10);
-	n2 = (currentDate.m_month % 10);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-	lcd_command ('/', DATA);
+	lcd_putNumber (1, 8, currentDate.m_month);
+	lcd_putString_P (1, 10, PSTR("/"), 1);
 	
 	/* Year */
-	n1 = (currentDate.m_year / 10);
-	n2 = (currentDate.m_year % 10);
-	lcd_command ('2', DATA);
-	lcd_command ('0', DATA);
-	lcd_command (ascii[n1], DATA);
-	lcd_command (ascii[n2], DATA);
-
-	lcd_command (CMD_RETURN_HOME, COMMAND); // return home
+	lcd_putString_P (1, 11, PSTR("20"), 2);
+	lcd_putNumber (1, 13, currentDate.m_year);
 }
-#endif
 
 void LCD_Off(void)
 {
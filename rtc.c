@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 
 #include "common.h"
 #include "rtc.h"
@@ -30,13 +31,520 @@
 #include "i2cmaster.h"
 #endif /* #ifdef DS1307_BOARD */
 
-volatile rtc_time_t clock;
 volatile rtc_time_t alarm_open;
 volatile rtc_time_t alarm_close;
+
+/* the only thing the ISR keeps, seconds since power up */
 volatile uint32_t secondTick;
+/* bumped by the ISR after every write to secondTick, so the main loop
+ * can read the tick without turning interrupts off */
+static volatile uint8_t rtc_seq;
+
+#define RTC_SECONDS_PER_DAY		86400UL
+/* a sync that moves the clock forward by up to this many seconds still
+ * fires any alarm it skipped over */
+#define RTC_SYNC_CATCHUP_MAX	300UL
+
+#ifdef RTC_TIMER2_ASYNC
+#ifndef ASSR
+#error "RTC_TIMER2_ASYNC needs an MCU with an asynchronous Timer2"
+#endif
+#if F_CPU > 8000000UL
+#error "RTC_TIMER2_ASYNC runs the core on the internal 8MHz RC oscillator"
+#endif
+#endif /* #ifdef RTC_TIMER2_ASYNC */
+
+#ifdef RTC_DS1307_SQW
+#ifndef DS1307_BOARD
+#error "RTC_DS1307_SQW needs a DS1307"
+#endif
+#ifdef RTC_TIMER2_ASYNC
+#error "pick one of RTC_DS1307_SQW and RTC_TIMER2_ASYNC"
+#endif
+/* Timer1 is left to the application, the part of a second comes from
+ * Timer3 instead */
+#ifndef TCCR3B
+#error "RTC_DS1307_SQW needs Timer3 for the part of a second"
+#endif
+#ifdef TIMER3_IN_USE
+#error "RTC_DS1307_SQW uses Timer3, it can't be shared"
+#endif
+#endif /* #ifdef RTC_DS1307_SQW */
+
+/* Timer1 runs in CTC mode off the system clock / 1024. One count is
+ * 64us at 16MHz, which is 64ppm of a second. */
+#define RTC_TIMER_COUNTS		(F_CPU / 1024UL)
+#define RTC_PPM_PER_COUNT		((int16_t)(1024000000UL / F_CPU))
+/* trim is clamped to this, anything further out is a broken crystal */
+#define RTC_TRIM_MAX			1000
+
+/* The counter behind secondTick, for the part of a second. Its flag is
+ * set when the second is up but the ISR hasn't counted it yet. */
+#ifdef RTC_TIMER2_ASYNC
+#define RTC_SUB_COUNT()			TCNT2
+#define RTC_SUB_PENDING()		(TIFR2 & (1 << TOV2))
+#define RTC_SUB_COUNTS			256UL
+#elif defined(RTC_DS1307_SQW)
+#define RTC_SUB_COUNT()			TCNT3
+#define RTC_SUB_PENDING()		(EIFR & (1 << INTF6))
+#define RTC_SUB_COUNTS			RTC_TIMER_COUNTS
+#else
+#define RTC_SUB_COUNT()			TCNT1
+#define RTC_SUB_PENDING()		(TIFR1 & (1 << OCF1A))
+#define RTC_SUB_COUNTS			RTC_TIMER_COUNTS
+#endif /* #ifdef RTC_TIMER2_ASYNC */
+
+/* ppm the timebase runs fast by. The ISR adds it up each second and
+ * stretches (or shortens) a second by one count each time the total
+ * passes a whole count, so any fraction of a count is carried over. */
+static volatile int16_t rtc_trim = 0;
+
+/* The clock is held as seconds since 1/1/2000 00:00:00 UTC, the
+ * epoch, which is secondTick + rtc_offset. Local time is that plus
+ * rtc_tz_offset, the time of day is local time modulo
+ * RTC_SECONDS_PER_DAY and the date comes from the day number. */
+static uint32_t rtc_offset = 0;
+
+/* zone as set, and the offset in force with the UTC time it next
+ * changes at. Worked out again once that time is reached. */
+static int16_t rtc_tz_std = 0;			/* minutes */
+static uint8_t rtc_tz_rule = RTC_TZ_RULE_NONE;
+static int32_t rtc_tz_offset = 0;		/* seconds */
+static uint32_t rtc_tz_next = 0;
+#define RTC_TZ_NEVER			0xffffffffUL
+
+/* last time worked out by RTC_GetTime, and the tick it belongs to */
+static rtc_time_t rtc_cache;
+static uint16_t rtc_cache_days;
+static uint32_t rtc_cache_tick;
+static uint8_t rtc_cache_valid = FALSE;
+
+/* Alarms as seconds of the day, and the tick each one next falls on.
+ * The ISR latches a match until the main loop takes it with
+ * RTC_TestAlarm. */
+static uint32_t alarm_open_sod;
+static uint32_t alarm_close_sod;
+static volatile uint32_t alarm_open_tick;
+static volatile uint32_t alarm_close_tick;
+static volatile uint8_t rtc_alarm_pending = RTC_ALARM_NONE;
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_secondsOfDay (rtc_time_t *time)
+{
+	return ((uint32_t)time->m_hour * 3600) + ((uint16_t)time->m_min * 60) + time->m_sec;
+}
+
+/* ------------------------------------------------------------------ */
+/* seconds from 'from' forward to 'to', across midnight if need be */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_secondsBetween (uint32_t from, uint32_t to)
+{
+	if (to >= from) {
+		return to - from;
+	}
+	return (RTC_SECONDS_PER_DAY - from) + to;
+}
+
+/* ------------------------------------------------------------------ */
+/* 4 byte read of secondTick, tried again if the ISR got in part way  */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_ticks (void)
+{
+	uint32_t tick;
+	uint8_t seq;
+
+	do {
+		seq = rtc_seq;
+		tick = secondTick;
+	} while (seq != rtc_seq);
+
+	return tick;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Milliseconds since power up, and the tick they fall in. The second
+ * is secondTick and the rest comes from the counter behind it, so the
+ * ms clock needs no interrupt of its own and keeps time whenever the
+ * seconds do. It wraps after 49 days.
+ *
+ * ------------------------------------------------------------------ */
+static uint32_t rtc_millis (uint32_t *pTick)
+{
+	uint32_t tick;
+	uint16_t count, ms;
+	uint8_t seq, pending;
+
+	/* same as rtc_ticks, and the ISR only bumps rtc_seq after its own
+	 * timer register writes, so a 16 bit count it spoiled part way
+	 * through is read again too */
+	do {
+		seq = rtc_seq;
+		tick = secondTick;
+		count = RTC_SUB_COUNT();
+		pending = RTC_SUB_PENDING();
+	} while (seq != rtc_seq);
+
+	/* the second is up but the ISR hasn't counted it yet */
+	if (pending && (count < (RTC_SUB_COUNTS / 2))) {
+		tick++;
+	}
+
+	/* a stretched second (trim) or a slow edge (SQW) can run past */
+	ms = ((uint32_t)count * 1000UL) / RTC_SUB_COUNTS;
+	if (ms > 999) {
+		ms = 999;
+	}
+
+	*pTick = tick;
+	return (tick * 1000UL) + ms;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Epoch seconds moved by a zone offset. Held at the epoch rather than
+ * wrapping, which a zone west of UTC does to a clock still at 1/1/2000
+ * (a new DS1307, or the POP-168's 16:00 boot default). The epoch runs
+ * past 2^31 in 2068, so this stays unsigned with the sign on the side.
+ *
+ * ------------------------------------------------------------------ */
+static uint32_t rtc_shift (uint32_t secs, int32_t offset)
+{
+	if (offset < 0) {
+		if (secs < (uint32_t)(-offset)) {
+			return 0;
+		}
+		return secs - (uint32_t)(-offset);
+	}
+	return secs + (uint32_t)offset;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_localAt (uint32_t tick)
+{
+	return rtc_shift (tick + rtc_offset, rtc_tz_offset);
+}
+
+/* ------------------------------------------------------------------ */
+/* local day number */
+/* ------------------------------------------------------------------ */
+static uint16_t rtc_dayAt (uint32_t tick)
+{
+	return rtc_localAt (tick) / RTC_SECONDS_PER_DAY;
+}
+
+/* ------------------------------------------------------------------ */
+/* local time of day */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_sodAt (uint32_t tick)
+{
+	return rtc_localAt (tick) % RTC_SECONDS_PER_DAY;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Calendar, on every board. The day number is the epoch clock's days,
+ * so the date moves on with the seconds and needs no tick of its own.
+ * Years are 2000-2099 (the DS1307's range, and two digits on the
+ * display), where every fourth year is a leap year, so a date is a day
+ * number with no loops or tables to walk: 365 a year plus a day for
+ * each leap year before it, plus the days before the month.
+ *
+ * ------------------------------------------------------------------ */
+/* days before each month, not a leap year */
+static const uint16_t rtc_month_start[13] PROGMEM = {
+	0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365
+};
+
+#define RTC_DAYS_PER_4YEARS		1461
+/* 1/1/2000 was a Saturday, m_dayNumber 7 */
+#define RTC_EPOCH_DAYNUMBER		7
+
+/* ------------------------------------------------------------------ */
+/* days before the start of month (0-12) in a year */
+/* ------------------------------------------------------------------ */
+static uint16_t rtc_monthStart (uint8_t month, uint8_t leap)
+{
+	uint16_t days = pgm_read_word (&rtc_month_start[month]);
+
+	if (leap && (month >= 2)) {
+		days++;
+	}
+	return days;
+}
+
+/* ------------------------------------------------------------------ */
+/* days since 1/1/2000, out of range fields are brought back in */
+/* ------------------------------------------------------------------ */
+static uint16_t rtc_daysFromDate (rtc_date_t *date)
+{
+	uint8_t year = date->m_year % 100;
+	uint8_t month = date->m_month;
+	uint16_t days;
+
+	if ((month < 1) || (month > 12)) {
+		month = 1;
+	}
+	days = ((uint16_t)year * 365) + ((year + 3) / 4);
+	days += rtc_monthStart (month - 1, (year & 0x03) == 0);
+	if (date->m_day > 0) {
+		days += date->m_day - 1;
+	}
+	return days;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void rtc_dateFromDays (uint16_t days, rtc_date_t *date)
+{
+	uint16_t quad = days / RTC_DAYS_PER_4YEARS;
+	uint16_t yday = days - (quad * RTC_DAYS_PER_4YEARS);
+	uint8_t year = quad * 4;
+	uint8_t leap = TRUE;
+	uint8_t month;
+
+	/* each block of four starts with the leap year */
+	if (yday >= 366) {
+		yday -= 366;
+		year += 1 + (yday / 365);
+		yday %= 365;
+		leap = FALSE;
+	}
+
+	/* no month is longer than 32 days, so this is at most one short */
+	month = yday / 32;
+	if (yday >= rtc_monthStart (month + 1, leap)) {
+		month++;
+	}
+
+	date->m_year = year;
+	date->m_month = month + 1;
+	date->m_day = yday - rtc_monthStart (month, leap) + 1;
+	date->m_dayNumber = ((days + RTC_EPOCH_DAYNUMBER - 1) % 7) + 1;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Daylight saving rules. Every change is on a Sunday: the nth or the
+ * last of a month, at an hour of local standard time, or of UTC where
+ * the whole region changes at once (EU).
+ *
+ * ------------------------------------------------------------------ */
+typedef struct {
+	uint8_t	m_month;	/* 1-12 */
+	uint8_t	m_week;		/* 1-4, or RTC_TZ_LAST */
+	uint8_t	m_hour;		/* standard time, or UTC | RTC_TZ_UTC */
+} rtc_tz_change_t;
+
+#define RTC_TZ_LAST				5
+#define RTC_TZ_UTC				0x80
+/* 0 = Sunday */
+#define RTC_WEEKDAY(days)		(((days) + RTC_EPOCH_DAYNUMBER - 1) % 7)
+
+/* summer time starts, then ends */
+static const rtc_tz_change_t rtc_tz_rules[RTC_TZ_RULE_MAX - 1][2] PROGMEM = {
+	/* EU: last Sunday in March to last Sunday in October, 01:00 UTC */
+	{{3, RTC_TZ_LAST, 1 | RTC_TZ_UTC}, {10, RTC_TZ_LAST, 1 | RTC_TZ_UTC}},
+	/* US: 2nd Sunday in March 02:00 to 1st Sunday in November 02:00
+	 * summer time (01:00 standard) */
+	{{3, 2, 2}, {11, 1, 1}},
+	/* AU (south east): 1st Sunday in October 02:00 to 1st Sunday in
+	 * April 03:00 summer time (02:00 standard) */
+	{{10, 1, 2}, {4, 1, 2}}
+};
+
+/* ------------------------------------------------------------------ */
+/* UTC of a change in the year (0-99) */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_tzChangeAt (const rtc_tz_change_t *change, uint8_t year)
+{
+	uint8_t month = pgm_read_byte (&change->m_month);
+	uint8_t week = pgm_read_byte (&change->m_week);
+	uint8_t hour = pgm_read_byte (&change->m_hour);
+	uint8_t leap = ((year & 0x03) == 0);
+	rtc_date_t date;
+	uint16_t days;
+	uint32_t utc;
+
+	date.m_day = 1;
+	date.m_month = month;
+	date.m_year = year;
+	days = rtc_daysFromDate (&date);
+	if (week == RTC_TZ_LAST) {
+		/* back from the last day of the month to a Sunday */
+		days += rtc_monthStart (month, leap) - rtc_monthStart (month - 1, leap) - 1;
+		days -= RTC_WEEKDAY (days);
+	}
+	else {
+		/* on to the first Sunday, then whole weeks */
+		days += (7 - RTC_WEEKDAY (days)) % 7;
+		days += (week - 1) * 7;
+	}
+
+	utc = ((uint32_t)days * RTC_SECONDS_PER_DAY) + ((uint32_t)(hour & ~RTC_TZ_UTC) * 3600);
+	if (!(hour & RTC_TZ_UTC)) {
+		utc -= (uint32_t)((int32_t)rtc_tz_std * 60);
+	}
+	return utc;
+}
+
+/* ------------------------------------------------------------------ */
+/* seconds local time is ahead of UTC at 'utc', and when that changes */
+/* ------------------------------------------------------------------ */
+static int32_t rtc_tzOffsetAt (uint32_t utc, uint32_t *pNext)
+{
+	const rtc_tz_change_t *rule;
+	int32_t offset = (int32_t)rtc_tz_std * 60;
+	uint32_t start, end;
+	uint8_t year, summer = FALSE;
+
+	*pNext = RTC_TZ_NEVER;
+	if ((rtc_tz_rule == RTC_TZ_RULE_NONE) || (rtc_tz_rule >= RTC_TZ_RULE_MAX)) {
+		return offset;
+	}
+	rule = rtc_tz_rules[rtc_tz_rule - 1];
+
+	/* nothing changes near new year, any offset gives the same year */
+	year = (uint8_t)(((utc / RTC_SECONDS_PER_DAY) * 4) / RTC_DAYS_PER_4YEARS);
+	start = rtc_tzChangeAt (&rule[0], year);
+	end = rtc_tzChangeAt (&rule[1], year);
+
+	if (start < end) {
+		/* north, summer inside the year */
+		if (utc < start) {
+			*pNext = start;
+		}
+		else if (utc < end) {
+			summer = TRUE;
+			*pNext = end;
+		}
+		else if (year < 99) {
+			*pNext = rtc_tzChangeAt (&rule[0], year + 1);
+		}
+	}
+	else {
+		/* south, summer across new year */
+		if (utc < end) {
+			summer = TRUE;
+			*pNext = end;
+		}
+		else if (utc < start) {
+			*pNext = start;
+		}
+		else {
+			summer = TRUE;
+			if (year < 99) {
+				*pNext = rtc_tzChangeAt (&rule[1], year + 1);
+			}
+		}
+	}
+
+	if (summer) {
+		offset += 3600;
+	}
+	return offset;
+}
+
+/* ------------------------------------------------------------------ */
+/* local day and time -> UTC, using the offset in force at that time */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_utcFrom (uint16_t days, uint32_t sod)
+{
+	uint32_t local = ((uint32_t)days * RTC_SECONDS_PER_DAY) + sod;
+	uint32_t next;
+	int32_t offset;
+
+	offset = rtc_tzOffsetAt (rtc_shift (local, -rtc_tz_offset), &next);
+	return rtc_shift (local, -offset);
+}
+
+/* ------------------------------------------------------------------ */
+/* first tick after 'tick' that lands on the given second of the day */
+/* ------------------------------------------------------------------ */
+static uint32_t rtc_nextTick (uint32_t tick, uint32_t sod)
+{
+	uint32_t wait = rtc_secondsBetween (rtc_sodAt (tick), sod);
+
+	if (wait == 0) {
+		wait = RTC_SECONDS_PER_DAY;
+	}
+	return tick + wait;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Move the clock and re-aim the alarms. The timer interrupt is held
+ * off so a second can't tick between working out the new offset and
+ * the alarm ticks. Any alarm stepped over by a small forward move (a
+ * DS1307 sync) is latched as if it had been matched.
+ *
+ * ------------------------------------------------------------------ */
+static void rtc_loadClock (uint32_t epoch, uint8_t catchUp)
+{
+	uint32_t tick, now, skipped, next;
+	int32_t zone = rtc_tzOffsetAt (epoch, &next);
+	uint8_t oldSREG = SREG;
+
+	cli();
+	tick = secondTick;
+	now = tick + rtc_offset;
+	skipped = epoch - now;
+	if (catchUp && (epoch > now) && (skipped <= RTC_SYNC_CATCHUP_MAX)) {
+		now = rtc_sodAt (tick);
+		if (rtc_secondsBetween (now, alarm_open_sod) - 1 < skipped) {
+			rtc_alarm_pending = RTC_ALARM_OPEN;
+		}
+		if (rtc_secondsBetween (now, alarm_close_sod) - 1 < skipped) {
+			rtc_alarm_pending = RTC_ALARM_CLOSE;
+		}
+	}
+	rtc_offset = epoch - tick;
+	rtc_tz_offset = zone;
+	rtc_tz_next = next;
+	alarm_open_tick = rtc_nextTick (tick, alarm_open_sod);
+	alarm_close_tick = rtc_nextTick (tick, alarm_close_sod);
+	SREG = oldSREG;
+
+	rtc_cache_valid = FALSE;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Once a pass, from the snapshot. Until the next daylight saving
+ * change this is the one compare. At the change the offset moves and
+ * the alarms are aimed again, they stay on local time.
+ *
+ * ------------------------------------------------------------------ */
+static void rtc_tzCheck (uint32_t tick)
+{
+	uint32_t utc = tick + rtc_offset;
+	uint32_t next;
+	int32_t zone;
+	uint8_t oldSREG;
+
+	if (utc < rtc_tz_next) {
+		return;
+	}
+
+	zone = rtc_tzOffsetAt (utc, &next);
+	oldSREG = SREG;
+	cli();
+	rtc_tz_next = next;
+	if (zone != rtc_tz_offset) {
+		rtc_tz_offset = zone;
+		tick = secondTick;
+		alarm_open_tick = rtc_nextTick (tick, alarm_open_sod);
+		alarm_close_tick = rtc_nextTick (tick, alarm_close_sod);
+		rtc_cache_valid = FALSE;
+	}
+	SREG = oldSREG;
+}
 
 #ifdef DS1307_BOARD
 #define RTC_SLAVE_ADDR 0xD0
+#define RTC_SCL_CLOCK  100000L	/* DS1307 is standard mode only */
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 static uint8_t rtc_bcd2dec (uint8_t bcd)
@@ -54,71 +562,343 @@ static uint8_t rtc_dec2bcd (uint8_t dec)
 }
 
 /* ------------------------------------------------------------------ */
+/* read len registers starting at reg, waits for the result */
 /* ------------------------------------------------------------------ */
-static void rtc_getTimeFromRTC (rtc_time_t *newTime)
+static uint8_t rtc_read (uint8_t reg, uint8_t *data, uint8_t len)
+{
+	i2c_xfer_t xfer;
+
+	xfer.addr = RTC_SLAVE_ADDR;
+	xfer.wbuf = &reg;
+	xfer.wlen = 1;
+	xfer.rbuf = data;
+	xfer.rlen = len;
+	xfer.done = NULL;
+	return i2c_transfer (&xfer);
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Queue a register write and return straight away. data[0] must be
+ * the first register address. The buffer is owned by the TWI engine
+ * until the next write.
+ *
+ * ------------------------------------------------------------------ */
+static uint8_t rtc_txbuf[8];
+static i2c_xfer_t rtc_xfer;
+
+static void rtc_write (uint8_t *data, uint8_t len)
 {
-	uint8_t data[3];
-	i2c_start (RTC_SLAVE_ADDR|I2C_WRITE);
-	i2c_write (0x00);
-	i2c_rep_start (RTC_SLAVE_ADDR|I2C_READ); /* set READ bit */
-	data[0] = i2c_readAck();
-	data[1] = i2c_readAck();
-	data[2] = i2c_readNak();
-	i2c_stop ();
-	
-	newTime->m_sec  = rtc_bcd2dec( (data[0] & 0x7f) );
-	newTime->m_min  = rtc_bcd2dec( (data[1] & 0x7f) );
-	newTime->m_hour = rtc_bcd2dec( (data[2] & 0x3f) );
+	uint8_t loop;
+
+	i2c_wait (&rtc_xfer);
+	for (loop=0; loop<len; loop++) {
+		rtc_txbuf[loop] = data[loop];
+	}
+	rtc_xfer.addr = RTC_SLAVE_ADDR;
+	rtc_xfer.wbuf = rtc_txbuf;
+	rtc_xfer.wlen = len;
+	rtc_xfer.rbuf = NULL;
+	rtc_xfer.rlen = 0;
+	rtc_xfer.done = NULL;
+	i2c_submit_wait (&rtc_xfer);
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Time and date are one burst of the seven clock registers, so the two
+ * can't come from either side of a midnight rollover. The day of the
+ * week register is ignored on read and written from the date.
+ *
+ * ------------------------------------------------------------------ */
+#define RTC_REG_SECONDS			0x00
+#define RTC_CLOCK_REGS			7
+
+static uint8_t rtc_readRTC (uint32_t *epoch)
+{
+	uint8_t data[RTC_CLOCK_REGS];
+	rtc_date_t date;
+
+	if (rtc_read (RTC_REG_SECONDS, data, RTC_CLOCK_REGS) != I2C_XFER_DONE) {
+		return FALSE;
+	}
+
+	date.m_day   = rtc_bcd2dec( (data[4] & 0x3f) );
+	date.m_month = rtc_bcd2dec( (data[5] & 0x1f) );
+	date.m_year  = rtc_bcd2dec( data[6] );
+	*epoch = ((uint32_t)rtc_daysFromDate (&date) * RTC_SECONDS_PER_DAY) +
+			((uint32_t)rtc_bcd2dec( (data[2] & 0x3f) ) * 3600) +
+			((uint16_t)rtc_bcd2dec( (data[1] & 0x7f) ) * 60) +
+			rtc_bcd2dec( (data[0] & 0x7f) );
+	return TRUE;
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
-static void rtc_writeTimeToRTC (rtc_time_t *newTime)
+static void rtc_writeRTC (uint32_t epoch)
 {
-	uint8_t data[4];
-	data[0] = 0x00; /* sets the first address*/
-	data[1] = (rtc_dec2bcd(newTime->m_sec) & 0x7f);
-	data[2] = (rtc_dec2bcd(newTime->m_min) & 0x7f);
-	data[3] = (rtc_dec2bcd(newTime->m_hour) & 0x3f);// | 0x40; /* set 12hr mode */
-	
-	i2c_start (RTC_SLAVE_ADDR|I2C_WRITE);
-	i2c_write (data[0]);
-	i2c_write (data[1]);
-	i2c_write (data[2]);
-	i2c_write (data[3]);
-	i2c_stop ();
+	uint8_t data[RTC_CLOCK_REGS + 1];
+	uint16_t days = epoch / RTC_SECONDS_PER_DAY;
+	uint32_t sod = epoch - ((uint32_t)days * RTC_SECONDS_PER_DAY);
+	uint16_t min = sod / 60;
+	rtc_date_t date;
+
+	rtc_dateFromDays (days, &date);
+
+	data[0] = RTC_REG_SECONDS; /* sets the first address*/
+	data[1] = (rtc_dec2bcd(sod - ((uint32_t)min * 60)) & 0x7f);
+	data[2] = (rtc_dec2bcd(min % 60) & 0x7f);
+	data[3] = (rtc_dec2bcd(min / 60) & 0x3f);// | 0x40; /* set 12hr mode */
+	data[4] = (rtc_dec2bcd(date.m_dayNumber) & 0x07);
+	data[5] = (rtc_dec2bcd(date.m_day) & 0x3f);
+	data[6] = (rtc_dec2bcd(date.m_month) & 0x1f);
+	data[7] = rtc_dec2bcd(date.m_year);
+
+	rtc_write (data, RTC_CLOCK_REGS + 1);
 }
+
+#ifndef RTC_DS1307_SQW
+/* ------------------------------------------------------------------ *
+ *
+ * Calibration against the DS1307. Both ends of a window are taken on
+ * the edge of a DS1307 second, and the local clock is read down to the
+ * timer count at that moment. Whatever the local clock gained or lost
+ * over the window, worked out as ppm, goes on to the trim.
+ *
+ * ------------------------------------------------------------------ */
+/* a window is at least this long, ~0.1ppm resolution at 16MHz */
+#define RTC_CAL_WINDOW			(6UL * 3600UL)
+/* DS1307 reads to try while waiting for its seconds to change */
+#define RTC_CAL_POLL_MAX		4000
+
+typedef struct {
+	uint32_t	m_epoch;
+	uint32_t	m_tick;
+	uint16_t	m_count;
+} rtc_cal_point_t;
+
+static rtc_cal_point_t rtc_cal_start;
+static uint8_t rtc_cal_running = FALSE;
+
+static uint8_t rtc_calPoint (rtc_cal_point_t *point)
+{
+	uint32_t first, now;
+	uint16_t tries;
+	uint8_t oldSREG;
+
+	if (!rtc_readRTC (&first)) {
+		return FALSE;
+	}
+	for (tries=0; tries<RTC_CAL_POLL_MAX; tries++) {
+		if (!rtc_readRTC (&now)) {
+			return FALSE;
+		}
+		if (now != first) {
+			oldSREG = SREG;
+			cli();
+			point->m_count = TCNT1;
+			point->m_tick = secondTick;
+			/* the timer wrapped but the ISR hasn't run yet */
+			if ((TIFR1 & (1 << OCF1A)) && (point->m_count < (RTC_TIMER_COUNTS / 2))) {
+				point->m_tick++;
+			}
+			SREG = oldSREG;
+			point->m_epoch = now;
+			return TRUE;
+		}
+	}
+	/* DS1307 oscillator stopped */
+	return FALSE;
+}
+#endif /* #ifndef RTC_DS1307_SQW */
 #endif /* DS1307_BOARD */
 
+#ifdef RTC_TIMER2_ASYNC
+/* ------------------------------------------------------------------ *
+ *
+ * Timer2 backend. A 32.768kHz watch crystal on TOSC1/TOSC2 (PB6/PB7)
+ * clocks Timer2 on its own, so it keeps counting in power-save with
+ * the core and the I/O clock stopped. Those are the XTAL pins, so the
+ * core runs on the internal 8MHz RC oscillator, trimmed against the
+ * watch crystal at start up so the serial LCD timing holds.
+ *
+ * Estimated supply current, from the ATmega168 datasheet typical
+ * figures at 5V. MCU only: the LCD module, its backlight, the LEDs,
+ * the motor driver and the regulator's own quiescent current come on
+ * top and on most boards dominate.
+ *
+ *   16MHz crystal, Timer1 backend, always running       ~9mA
+ *   8MHz RC, Timer2 backend, awake                       ~4.5mA
+ *   8MHz RC, Timer2 backend, power-save                  ~1.5uA
+ *   Timer2 backend averaged over a day (awake ~1ms of
+ *   each second, plus door moves and menu use)           ~10uA
+ *
+ * The last two only hold with the heartbeat LED off, which is how the
+ * Timer2 build leaves it: lit half the time it alone costs mA.
+ *
+ * ------------------------------------------------------------------ */
+/* system clock cycles in one Timer2 count (256Hz) */
+#define RTC_OSC_TARGET			(F_CPU / 256UL)
+/* close enough, about 0.5% */
+#define RTC_OSC_TOLERANCE		(RTC_OSC_TARGET / 200)
+#define RTC_OSC_TRIES			128
+
 /* ------------------------------------------------------------------ */
+/* system clock cycles between two Timer2 counts, 0 if it isn't running */
 /* ------------------------------------------------------------------ */
-void RTC_Init (void)
+static uint16_t rtc_oscMeasure (void)
 {
-	// Use timer1 16 bit.
-	// Divide system clock by 1024 (16MHz/1024 = 15625 = 1s)
+	uint8_t count = TCNT2;
+
+	/* a Timer1 overflow takes longer than two Timer2 counts */
+	TCNT1 = 0;
+	TIFR1 = (1 << TOV1);
+	while (TCNT2 == count) {
+		if (TIFR1 & (1 << TOV1)) {
+			return 0;
+		}
+	}
+	TCNT1 = 0;
+	count = TCNT2;
+	while (TCNT2 == count) {
+		if (TIFR1 & (1 << TOV1)) {
+			return 0;
+		}
+	}
+	return TCNT1;
+}
+
+/* ------------------------------------------------------------------ */
+/* walk OSCCAL until the RC oscillator matches the watch crystal */
+/* ------------------------------------------------------------------ */
+static void rtc_tuneOscillator (void)
+{
+	uint16_t cycles;
+	uint8_t tries;
+
+	/* Timer1 isn't used for the time with this backend */
 	TCCR1A = 0;
-	TCCR1B = 0x05;
+	TCCR1B = (1 << CS10);
+	for (tries=0; tries<RTC_OSC_TRIES; tries++) {
+		cycles = rtc_oscMeasure ();
+		if (cycles == 0) {
+			/* crystal still starting up */
+			continue;
+		}
+		if (cycles > (RTC_OSC_TARGET + RTC_OSC_TOLERANCE)) {
+			OSCCAL--;
+		}
+		else if (cycles < (RTC_OSC_TARGET - RTC_OSC_TOLERANCE)) {
+			OSCCAL++;
+		}
+		else {
+			break;
+		}
+	}
+	TCCR1B = 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void RTC_Init (void)
+{
+	// Use timer2 asynchronous, 32768Hz/128 = 256Hz, overflows at 1s
+	TIMSK2 = 0;
+	ASSR = (1 << AS2);
+	TCNT2 = 0;
+	TCCR2A = 0;
+	TCCR2B = (1 << CS22) | (1 << CS20);
+	while (ASSR & ((1 << TCN2UB) | (1 << TCR2AUB) | (1 << TCR2BUB)));
 
-	TCCR1C = 0x80; // force compare A
+	rtc_tuneOscillator ();
 
-	//OCR1AH = ((15625 << 8) & 0xff);
-	//OCR1AL = (15625 & 0xff);
-	OCR1A = 15625;
-	TIMSK1 = 0x02; //output compare A match interrupt enable
+	TIFR2 = (1 << TOV2) | (1 << OCF2A) | (1 << OCF2B);
+	TIMSK2 = (1 << TOIE2);
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Call with interrupts off just before sleeping. Timer2 can't wake
+ * the core again until a write has made it across into the crystal's
+ * clock domain, which matters when a pass of the main loop is shorter
+ * than one 32kHz cycle.
+ *
+ * ------------------------------------------------------------------ */
+void RTC_SleepReady (void)
+{
+	OCR2A = 0;
+	while (ASSR & (1 << OCR2AUB));
+}
+
+#elif defined(RTC_DS1307_SQW)
+/* ------------------------------------------------------------------ *
+ *
+ * DS1307 backend. The chip's 1Hz square wave (SQW/OUT, open drain) on
+ * D7 (PE6/INT6) ticks the clock, so it keeps the DS1307's time to the
+ * second and Timer1 is left free. Timer3 times the part of a second.
+ * The seconds register moves on the falling edge.
+ *
+ * ------------------------------------------------------------------ */
+#define RTC_REG_CONTROL			0x07
+#define RTC_CONTROL_SQWE_1HZ	0x10	/* SQWE, RS1:0 = 00 */
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void RTC_Init (void)
+{
+	uint8_t data[2];
 
+	i2c_probe (RTC_SLAVE_ADDR, RTC_SCL_CLOCK);
+
+	data[0] = RTC_REG_CONTROL;
+	data[1] = RTC_CONTROL_SQWE_1HZ;
+	rtc_write (data, 2);
+
+	/* input with pull up, interrupt on the falling edge */
+	DDRE &= ~(1 << PE6);
+	PORTE |= (1 << PE6);
+	EICRB = (EICRB & ~((1 << ISC61) | (1 << ISC60))) | (1 << ISC61);
+	EIFR = (1 << INTF6);
+	EIMSK |= (1 << INT6);
+
+	/* Timer3 free runs at clk/1024 and each edge zeroes it, which
+	 * gives the part of a second for the ms clock */
+	TCCR3A = 0;
+	TCNT3 = 0;
+	TCCR3B = (1 << CS32) | (1 << CS30);
+}
+
+#else /* #ifdef RTC_TIMER2_ASYNC */
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void RTC_Init (void)
+{
+	// Use timer1 16 bit, CTC mode so the hardware clears the count
+	// on the match and no counts are lost to interrupt latency.
+	// Divide system clock by 1024 (16MHz/1024 = 15625 = 1s)
+	TCCR1A = 0;
 	TCNT1 = 0;
+	OCR1A = RTC_TIMER_COUNTS - 1;
+	TCCR1B = (1 << WGM12) | (1 << CS12) | (1 << CS10);
+	TIMSK1 = 0x02; //output compare A match interrupt enable
+
+#ifdef DS1307_BOARD
+	i2c_probe (RTC_SLAVE_ADDR, RTC_SCL_CLOCK);
+#endif /* #ifdef DS1307_BOARD */
 }
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void RTC_SyncTime (void)
 {
 #ifdef DS1307_BOARD
-	rtc_time_t newTime;
-	rtc_getTimeFromRTC (&newTime);
-	clock.m_sec = newTime.m_sec;
-	clock.m_min = newTime.m_min;
-	clock.m_hour = newTime.m_hour;
+	uint32_t epoch;
+	if (!rtc_readRTC (&epoch)) {
+		/* bus error, keep free running on the local clock */
+		return;
+	}
+	rtc_loadClock (epoch, TRUE);
 #endif /* #ifdef DS1307_BOARD */
 }
 
@@ -127,39 +907,107 @@ void RTC_SyncTime (void)
 /* ------------------------------------------------------------------ */
 void RTC_SetTime (rtc_time_t *newTime)
 {
+	/* same day, new time, both local */
+	uint32_t epoch = rtc_utcFrom (rtc_dayAt (rtc_ticks ()), rtc_secondsOfDay (newTime));
+
 #ifdef DS1307_BOARD
-	rtc_writeTimeToRTC (newTime);
+	rtc_writeRTC (epoch);
 #endif /* #ifdef DS1307_BOARD */
-	clock.m_sec = newTime->m_sec;
-	clock.m_min = newTime->m_min;
-	clock.m_hour = newTime->m_hour;
+	/* a time set by hand doesn't fire the alarms it passes */
+	rtc_loadClock (epoch, FALSE);
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void RTC_SetOpenTime (rtc_time_t *newTime)
 {
+	uint8_t oldSREG;
+
 	alarm_open.m_sec = newTime->m_sec;
 	alarm_open.m_min = newTime->m_min;
 	alarm_open.m_hour = newTime->m_hour;
+	alarm_open_sod = rtc_secondsOfDay (newTime);
+
+	/* 32 bit, so keep the ISR out while it changes */
+	oldSREG = SREG;
+	cli();
+	alarm_open_tick = rtc_nextTick (secondTick, alarm_open_sod);
+	SREG = oldSREG;
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void RTC_SetCloseTime (rtc_time_t *newTime)
 {
+	uint8_t oldSREG;
+
 	alarm_close.m_sec = newTime->m_sec;
 	alarm_close.m_min = newTime->m_min;
 	alarm_close.m_hour = newTime->m_hour;
+	alarm_close_sod = rtc_secondsOfDay (newTime);
+
+	/* 32 bit, so keep the ISR out while it changes */
+	oldSREG = SREG;
+	cli();
+	alarm_close_tick = rtc_nextTick (secondTick, alarm_close_sod);
+	SREG = oldSREG;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void rtc_timeAt (uint32_t tick, rtc_time_t *pTime)
+{
+	uint32_t sod;
+	uint16_t min;
+
+	if (!rtc_cache_valid || (tick != rtc_cache_tick)) {
+		if (rtc_cache_valid && (tick == rtc_cache_tick + 1) &&
+				(rtc_cache.m_sec != 59)) {
+			/* next second of the same minute, the common case */
+			rtc_cache.m_sec++;
+		}
+		else {
+			sod = rtc_localAt (tick);
+			rtc_cache_days = sod / RTC_SECONDS_PER_DAY;
+			sod -= (uint32_t)rtc_cache_days * RTC_SECONDS_PER_DAY;
+			min = sod / 60;
+			rtc_cache.m_sec = sod - ((uint32_t)min * 60);
+			rtc_cache.m_hour = min / 60;
+			rtc_cache.m_min = min - (rtc_cache.m_hour * 60);
+		}
+		rtc_cache_tick = tick;
+		rtc_cache_valid = TRUE;
+	}
+
+	pTime->m_sec = rtc_cache.m_sec;
+	pTime->m_min = rtc_cache.m_min;
+	pTime->m_hour = rtc_cache.m_hour;
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 void RTC_GetTime (rtc_time_t *pTime)
 {
-	pTime->m_sec = clock.m_sec;
-	pTime->m_min = clock.m_min;
-	pTime->m_hour = clock.m_hour;
+	uint32_t tick = rtc_ticks ();
+
+	rtc_tzCheck (tick);
+	rtc_timeAt (tick, pTime);
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * The tick and the time of day it stands for, read together. Nothing
+ * read from one snapshot can disagree with anything else in it, so a
+ * pass of the main loop works off one of these rather than going back
+ * to the clock each time it needs it.
+ *
+ * ------------------------------------------------------------------ */
+void RTC_GetSnapshot (rtc_snapshot_t *snap)
+{
+	snap->m_ms = rtc_millis (&snap->m_tick);
+	rtc_tzCheck (snap->m_tick);
+	rtc_timeAt (snap->m_tick, &snap->m_time);
+	snap->m_days = rtc_cache_days;
 }
 
 /* ------------------------------------------------------------------ */
@@ -184,89 +1032,296 @@ void RTC_GetCloseTime (rtc_time_t *pTime)
 /* ------------------------------------------------------------------ */
 uint8_t RTC_TestAlarm (void)
 {
-	rtc_time_t alarms[2] = {alarm_open, alarm_close};
-	uint8_t loop = 0;
-	for (loop=0; loop<2; loop++) {
-		if ((alarms[loop].m_hour == clock.m_hour) &&
-				(alarms[loop].m_min == clock.m_min) &&
-				(alarms[loop].m_sec == clock.m_sec)) {
-			return loop+RTC_ALARM_OPEN;
-		}
+	uint8_t alarm;
+	uint8_t oldSREG;
+
+	/* nothing latched, the usual case */
+	if (rtc_alarm_pending == RTC_ALARM_NONE) {
+		return RTC_ALARM_NONE;
+	}
+
+	/* take it, without losing one the ISR latches in between */
+	oldSREG = SREG;
+	cli();
+	alarm = rtc_alarm_pending;
+	rtc_alarm_pending = RTC_ALARM_NONE;
+	SREG = oldSREG;
+
+	return alarm;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Boot catch-up. Whatever happened while the power was off, the door
+ * should end up where the schedule has it now: latch whichever alarm
+ * fell most recently before the current time.
+ *
+ * ------------------------------------------------------------------ */
+void RTC_CatchUpAlarm (void)
+{
+	uint32_t now = rtc_sodAt (rtc_ticks ());
+	uint32_t sinceOpen, sinceClose;
+
+	sinceOpen = rtc_secondsBetween (alarm_open_sod, now);
+	sinceClose = rtc_secondsBetween (alarm_close_sod, now);
+	if (sinceOpen < sinceClose) {
+		rtc_alarm_pending = RTC_ALARM_OPEN;
+	}
+	else if (sinceClose < sinceOpen) {
+		rtc_alarm_pending = RTC_ALARM_CLOSE;
 	}
-	return RTC_ALARM_NONE;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void RTC_SetTrim (int16_t ppm)
+{
+	uint8_t oldSREG;
+
+	if (ppm > RTC_TRIM_MAX || ppm < -RTC_TRIM_MAX) {
+		ppm = 0;
+	}
+	/* 16 bit, so keep the ISR out while it changes */
+	oldSREG = SREG;
+	cli();
+	rtc_trim = ppm;
+	SREG = oldSREG;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+int16_t RTC_GetTrim (void)
+{
+	return rtc_trim;
+}
+
+/* ------------------------------------------------------------------ *
+ *
+ * Called now and then from the main loop. The first call starts a
+ * window, a call once the window is long enough measures it, moves
+ * the trim and starts the next. Returns TRUE when the trim changed and
+ * is worth saving. Can wait up to a second for the DS1307 to tick.
+ *
+ * ------------------------------------------------------------------ */
+uint8_t RTC_Calibrate (void)
+{
+#if defined(DS1307_BOARD) && !defined(RTC_DS1307_SQW)
+	rtc_cal_point_t end;
+	uint32_t elapsed;
+	int32_t error;
+	int16_t trim;
+
+	if (rtc_cal_running && ((rtc_ticks () - rtc_cal_start.m_tick) < RTC_CAL_WINDOW)) {
+		return FALSE;
+	}
+	if (!rtc_calPoint (&end)) {
+		/* start again from scratch next time */
+		rtc_cal_running = FALSE;
+		return FALSE;
+	}
+	if (!rtc_cal_running) {
+		rtc_cal_start = end;
+		rtc_cal_running = TRUE;
+		return FALSE;
+	}
+
+	/* counts the local clock ran ahead of the DS1307 */
+	elapsed = end.m_epoch - rtc_cal_start.m_epoch;
+	error = (int32_t)((end.m_tick - rtc_cal_start.m_tick) - elapsed) * (int32_t)RTC_TIMER_COUNTS;
+	error += (int32_t)end.m_count - (int32_t)rtc_cal_start.m_count;
+	rtc_cal_start = end;
+	if (elapsed == 0) {
+		return FALSE;
+	}
+
+	/* counts -> ppm, rounded */
+	error *= RTC_PPM_PER_COUNT;
+	if (error < 0) {
+		error -= (int32_t)(elapsed / 2);
+	}
+	else {
+		error += (int32_t)(elapsed / 2);
+	}
+	error /= (int32_t)elapsed;
+	if (error == 0) {
+		return FALSE;
+	}
+
+	trim = rtc_trim + error;
+	if (trim > RTC_TRIM_MAX) {
+		trim = RTC_TRIM_MAX;
+	}
+	else if (trim < -RTC_TRIM_MAX) {
+		trim = -RTC_TRIM_MAX;
+	}
+	RTC_SetTrim (trim);
+	return TRUE;
+#else
+	return FALSE;
+#endif /* #if defined(DS1307_BOARD) && !defined(RTC_DS1307_SQW) */
 }
 
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 uint32_t RTC_GetSecondTick (void)
 {
-	return secondTick;
+	return rtc_ticks ();
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint32_t RTC_GetMillis (void)
+{
+	uint32_t tick;
+
+	return rtc_millis (&tick);
 }
 
-#ifdef DS1307_BOARD
 /* ------------------------------------------------------------------ */
+/* m_dayNumber is ignored, it follows from the date */
 /* ------------------------------------------------------------------ */
 void RTC_SetDate (rtc_date_t *newDate)
 {
-	uint8_t data[5];
-	
-	data[0] = 0x03; /* set register to DAY */
-	data[1] = (rtc_dec2bcd(newDate->m_dayNumber) & 0x07);
-	data[2] = (rtc_dec2bcd(newDate->m_day) & 0x3f);
-	data[3] = (rtc_dec2bcd(newDate->m_month) & 0x1f);
-	data[4] = (rtc_dec2bcd(newDate->m_year) & 0xff);
-	
-	i2c_start (RTC_SLAVE_ADDR|I2C_WRITE);
-	i2c_write (data[0]);
-	i2c_write (data[1]);
-	i2c_write (data[2]);
-	i2c_write (data[3]);
-	i2c_write (data[4]);
-	i2c_stop ();
+	/* new day, same time, both local */
+	uint32_t epoch = rtc_utcFrom (rtc_daysFromDate (newDate), rtc_sodAt (rtc_ticks ()));
+
+#ifdef DS1307_BOARD
+	rtc_writeRTC (epoch);
+#endif /* #ifdef DS1307_BOARD */
+	rtc_loadClock (epoch, FALSE);
 }
 
 /* ------------------------------------------------------------------ */
+/* from the local clock, no bus traffic */
 /* ------------------------------------------------------------------ */
 void RTC_GetDate (rtc_date_t *date)
 {
-	uint8_t data[4];
-	
-	i2c_start (RTC_SLAVE_ADDR|I2C_WRITE);
-	i2c_write (0x03); /* set register to DAY */
-	i2c_rep_start (RTC_SLAVE_ADDR|I2C_READ); /* set READ bit */
-	data[0] = i2c_readAck();
-	data[1] = i2c_readAck();
-	data[2] = i2c_readAck();
-	data[3] = i2c_readNak();
-	i2c_stop ();
-	
-	date->m_dayNumber = rtc_bcd2dec( (data[0] & 0x07) );
-	date->m_day       = rtc_bcd2dec( (data[1] & 0x3f) );
-	date->m_month     = rtc_bcd2dec( (data[2] & 0x1f) );
-	date->m_year      = rtc_bcd2dec( (data[3] & 0xff) );
+	rtc_dateFromDays (rtc_dayAt (rtc_ticks ()), date);
 }
-#endif
 
-#define Led1Toggle()	(PIND |= (1 << PD2))
+/* ------------------------------------------------------------------ */
+/* 0 = 1st January */
+/* ------------------------------------------------------------------ */
+uint16_t RTC_DayOfYear (rtc_date_t *date)
+{
+	uint8_t month = date->m_month;
+
+	if ((month < 1) || (month > 12)) {
+		month = 1;
+	}
+	return rtc_monthStart (month - 1, (date->m_year & 0x03) == 0) + date->m_day - 1;
+}
+
+/* ------------------------------------------------------------------ */
+/* length of the date's month, 28-31 */
+/* ------------------------------------------------------------------ */
+uint8_t RTC_DaysInMonth (rtc_date_t *date)
+{
+	uint8_t month = date->m_month;
+	uint8_t leap = ((date->m_year & 0x03) == 0);
+
+	if ((month < 1) || (month > 12)) {
+		month = 1;
+	}
+	return rtc_monthStart (month, leap) - rtc_monthStart (month - 1, leap);
+}
+
+/* ------------------------------------------------------------------ */
+/* fill in m_dayNumber for the day, month and year */
+/* ------------------------------------------------------------------ */
+void RTC_DayOfWeek (rtc_date_t *date)
+{
+	date->m_dayNumber = ((rtc_daysFromDate (date) + RTC_EPOCH_DAYNUMBER - 1) % 7) + 1;
+}
+
+/* ------------------------------------------------------------------ */
+/* standard time offset in minutes, east of UTC is +ve */
+/* ------------------------------------------------------------------ */
+void RTC_SetTimezone (int16_t stdOffset, uint8_t rule)
+{
+	if (rule >= RTC_TZ_RULE_MAX) {
+		rule = RTC_TZ_RULE_NONE;
+	}
+	rtc_tz_std = stdOffset;
+	rtc_tz_rule = rule;
+
+	/* work the offset out again now, and aim the alarms by it */
+	rtc_tz_next = 0;
+	rtc_tzCheck (rtc_ticks ());
+}
+
+/* ------------------------------------------------------------------ */
+/* minutes local time is ahead of UTC at noon on a (local) date */
+/* ------------------------------------------------------------------ */
+int16_t RTC_GetUtcOffset (rtc_date_t *date)
+{
+	uint32_t noon = ((uint32_t)rtc_daysFromDate (date) * RTC_SECONDS_PER_DAY) + (RTC_SECONDS_PER_DAY / 2);
+	uint32_t next;
+
+	return (int16_t)(rtc_tzOffsetAt (rtc_shift (noon, -((int32_t)rtc_tz_std * 60)), &next) / 60);
+}
+
+/* ------------------------------------------------------------------ */
+/* one second gone, shared by both timer backends */
+static inline void rtc_tick (void)
+{
+	uint32_t tick = secondTick + 1;
+
+	secondTick = tick;
+	rtc_seq++;
+
+	if (tick == alarm_open_tick) {
+		alarm_open_tick = tick + RTC_SECONDS_PER_DAY;
+		rtc_alarm_pending = RTC_ALARM_OPEN;
+	}
+	if (tick == alarm_close_tick) {
+		alarm_close_tick = tick + RTC_SECONDS_PER_DAY;
+		rtc_alarm_pending = RTC_ALARM_CLOSE;
+	}
+}
+
+#ifdef RTC_TIMER2_ASYNC
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+ISR(TIMER2_OVF_vect)
+{
+	/* the watch crystal is its own reference, no trim */
+	rtc_tick ();
+}
+
+#elif defined(RTC_DS1307_SQW)
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+ISR(INT6_vect)
+{
+	/* the DS1307 is the reference, no trim */
+	TCNT3 = 0;
+	rtc_tick ();
+}
+
+#else /* #ifdef RTC_TIMER2_ASYNC */
 /* ------------------------------------------------------------------ */
 /* ------------------------------------------------------------------ */
 ISR(TIMER1_COMPA_vect)
 {
-	TCNT1 = 0;
-	clock.m_sec++;
-	secondTick++;
-	if (clock.m_sec == 60) {
-		clock.m_sec = 0;
-		clock.m_min++;
-		if (clock.m_min == 60) {
-			clock.m_min = 0;
-			clock.m_hour++;
-			if (clock.m_hour == 24) {
-				clock.m_hour = 0;
-			}
-		}
+	static int16_t rtc_trim_acc = 0;
+
+	/* still early in the next second, so the new top applies to it */
+	rtc_trim_acc += rtc_trim;
+	if (rtc_trim_acc >= RTC_PPM_PER_COUNT) {
+		rtc_trim_acc -= RTC_PPM_PER_COUNT;
+		OCR1A = RTC_TIMER_COUNTS;
 	}
-	Led1Toggle();
+	else if (rtc_trim_acc <= -RTC_PPM_PER_COUNT) {
+		rtc_trim_acc += RTC_PPM_PER_COUNT;
+		OCR1A = RTC_TIMER_COUNTS - 2;
+	}
+	else {
+		OCR1A = RTC_TIMER_COUNTS - 1;
+	}
+
+	rtc_tick ();
 }
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 
 /* EOF */
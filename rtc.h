@@ -23,14 +23,12 @@
 #ifndef _RTC_H
 #define _RTC_H
 
-#ifdef DS1307_BOARD
 typedef struct {
 	uint8_t m_dayNumber; /* 1 = Sunday */
 	uint8_t m_day;
 	uint8_t m_month;
 	uint8_t m_year;
 } rtc_date_t;
-#endif /* #ifdef DS1307_BOARD */
 
 typedef struct {
 	uint8_t	m_hour;
@@ -38,6 +36,22 @@ typedef struct {
 	uint8_t m_sec;
 } rtc_time_t;
 
+typedef struct {
+	uint32_t	m_tick;
+	rtc_time_t	m_time;
+	uint16_t	m_days;		/* since 1/1/2000 */
+	uint32_t	m_ms;		/* since power up, wraps */
+} rtc_snapshot_t;
+
+/* daylight saving rules */
+enum {
+	RTC_TZ_RULE_NONE = 0,
+	RTC_TZ_RULE_EU,
+	RTC_TZ_RULE_US,
+	RTC_TZ_RULE_AU,
+	RTC_TZ_RULE_MAX
+};
+
 enum {
 	RTC_ALARM_NONE = 0,
 	RTC_ALARM_OPEN,
@@ -54,12 +68,25 @@ void RTC_GetOpenTime (rtc_time_t *pTime);
 void RTC_GetCloseTime (rtc_time_t *pTime);
 
 uint8_t  RTC_TestAlarm (void);
+void     RTC_CatchUpAlarm (void);
 uint32_t RTC_GetSecondTick (void);
+uint32_t RTC_GetMillis (void);
+void     RTC_GetSnapshot (rtc_snapshot_t *snap);
+
+void     RTC_SetTrim (int16_t ppm);
+int16_t  RTC_GetTrim (void);
+uint8_t  RTC_Calibrate (void);
+#ifdef RTC_TIMER2_ASYNC
+void     RTC_SleepReady (void);
+#endif /* #ifdef RTC_TIMER2_ASYNC */
 
-#ifdef DS1307_BOARD
 void RTC_SetDate (rtc_date_t *newDate);
 void RTC_GetDate (rtc_date_t *date);
-#endif
+void RTC_DayOfWeek (rtc_date_t *date);
+uint16_t RTC_DayOfYear (rtc_date_t *date);
+uint8_t RTC_DaysInMonth (rtc_date_t *date);
+void RTC_SetTimezone (int16_t stdOffset, uint8_t rule);
+int16_t RTC_GetUtcOffset (rtc_date_t *date);
 
 #endif /* #ifndef _RTC_H */
 
@@ -0,0 +1,159 @@
+/*
+ * Filename		: soft-timer.c
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: Millisecond software timers for the controller timeouts.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+#include <inttypes.h>
+
+#include "common.h"
+#include "soft-timer.h"
+
+/* ------------------------------------------------------------------ *
+ *
+ * Timers run off the millisecond clock the main loop hands to
+ * TIMER_Update once a pass, so everything in a pass sees the same
+ * time and there's no interrupt of their own. Times are compared by
+ * their difference, so the 49 day wrap of the ms clock doesn't matter
+ * as long as no timer is longer than half that.
+ *
+ * The earliest deadline is kept, so a pass where nothing is due costs
+ * one compare however many timers are running. Only when it's passed
+ * are the timers walked to flag the ones that expired, restart the
+ * periodic ones and find the next deadline.
+ *
+ * ------------------------------------------------------------------ */
+#define TIMER_F_RUNNING		0x01
+#define TIMER_F_EXPIRED		0x02
+
+typedef struct {
+	uint32_t	m_due;
+	uint32_t	m_period;	/* 0 for a one shot */
+	uint8_t		m_flags;
+} soft_timer_t;
+
+static soft_timer_t timer_list[TIMER_MAX];
+static uint8_t timer_count = 0;
+
+static uint32_t timer_now = 0;
+static uint32_t timer_next;
+static uint8_t timer_armed = FALSE;
+
+/* TRUE once 'now' has reached 'due' */
+#define timer_reached(now, due)		((int32_t)((now) - (due)) >= 0)
+
+/* ------------------------------------------------------------------ */
+/* TIMER_INVALID once they've all gone */
+/* ------------------------------------------------------------------ */
+timer_handle_t TIMER_Create (void)
+{
+	if (timer_count >= TIMER_MAX) {
+		return TIMER_INVALID;
+	}
+	timer_list[timer_count].m_flags = 0;
+	return timer_count++;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+void TIMER_Update (uint32_t now)
+{
+	soft_timer_t *timer;
+	uint8_t i;
+
+	timer_now = now;
+	if (!timer_armed || !timer_reached (now, timer_next)) {
+		return;
+	}
+
+	timer_armed = FALSE;
+	for (i=0, timer=timer_list; i<timer_count; i++, timer++) {
+		if (!(timer->m_flags & TIMER_F_RUNNING)) {
+			continue;
+		}
+		if (timer_reached (now, timer->m_due)) {
+			timer->m_flags |= TIMER_F_EXPIRED;
+			if (timer->m_period == 0) {
+				timer->m_flags &= ~TIMER_F_RUNNING;
+				continue;
+			}
+			timer->m_due += timer->m_period;
+			if (timer_reached (now, timer->m_due)) {
+				/* fell behind (asleep), don't try to catch up */
+				timer->m_due = now + timer->m_period;
+			}
+		}
+		if (!timer_armed || !timer_reached (timer->m_due, timer_next)) {
+			timer_next = timer->m_due;
+			timer_armed = TRUE;
+		}
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* (re)start, ms from the time of the last update */
+/* ------------------------------------------------------------------ */
+void TIMER_Start (timer_handle_t timer, uint32_t ms, uint8_t mode)
+{
+	soft_timer_t *t = &timer_list[timer];
+
+	t->m_due = timer_now + ms;
+	t->m_period = (mode == TIMER_PERIODIC) ? ms : 0;
+	t->m_flags = TIMER_F_RUNNING;
+
+	if (!timer_armed || !timer_reached (t->m_due, timer_next)) {
+		timer_next = t->m_due;
+		timer_armed = TRUE;
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* the deadline is left, the next update just finds nothing due */
+/* ------------------------------------------------------------------ */
+void TIMER_Stop (timer_handle_t timer)
+{
+	timer_list[timer].m_flags = 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint8_t TIMER_Running (timer_handle_t timer)
+{
+	return (timer_list[timer].m_flags & TIMER_F_RUNNING) ? TRUE : FALSE;
+}
+
+/* ------------------------------------------------------------------ */
+/* TRUE once for each expiry, clears it */
+/* ------------------------------------------------------------------ */
+uint8_t TIMER_Expired (timer_handle_t timer)
+{
+	soft_timer_t *t = &timer_list[timer];
+
+	if (t->m_flags & TIMER_F_EXPIRED) {
+		t->m_flags &= ~TIMER_F_EXPIRED;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+/* EOF */
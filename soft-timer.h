@@ -0,0 +1,50 @@
+/*
+ * Filename		: soft-timer.h
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: Millisecond software timers for the controller timeouts.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+#ifndef _SOFT_TIMER_H
+#define _SOFT_TIMER_H
+
+#include <inttypes.h>
+
+/* handles, one per timer, handed out at start up */
+#ifndef TIMER_MAX
+#define TIMER_MAX		4
+#endif
+#define TIMER_INVALID	0xff
+
+typedef uint8_t timer_handle_t;
+
+enum {
+	TIMER_ONE_SHOT = 0,
+	TIMER_PERIODIC
+};
+
+timer_handle_t TIMER_Create (void);
+void    TIMER_Update (uint32_t now);
+void    TIMER_Start (timer_handle_t timer, uint32_t ms, uint8_t mode);
+void    TIMER_Stop (timer_handle_t timer);
+uint8_t TIMER_Running (timer_handle_t timer);
+uint8_t TIMER_Expired (timer_handle_t timer);
+
+#endif /* #ifndef _SOFT_TIMER_H */
+
+/* EOF */
@@ -0,0 +1,183 @@
+/*
+ * Filename		: sun-times.c
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: Sunrise and sunset times for the light door mode,
+ *				  fixed point only.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+#include <avr/pgmspace.h>
+#include <inttypes.h>
+
+#include "common.h"
+#include "sun-times.h"
+
+/* ------------------------------------------------------------------ *
+ *
+ * NOAA's fractional year method: the Spencer series for the sun's
+ * declination and the equation of time, then the hour angle at which
+ * the sun's centre is 0.833 degrees below the horizon (refraction and
+ * the size of the disc). Good to a minute or so away from the poles.
+ *
+ * Angles are binary, 65536 to a turn, so they wrap on their own.
+ * Sines and cosines are Q14 (16384 = 1.0) from a quarter wave table.
+ *
+ * ------------------------------------------------------------------ */
+#define SUN_ONE					16384L
+#define SUN_QUARTER				16384U
+#define SUN_HALF				32768U
+
+#define SUN_SECONDS_PER_DAY		86400L
+/* sin(-0.833 degrees), Q14 */
+#define SUN_SIN_HORIZON			(-238L)
+
+/* sin 0..90 degrees in 64 steps, Q14 */
+static const int16_t sun_sine[65] PROGMEM = {
+	    0,   402,   804,  1205,  1606,  2006,  2404,  2801,
+	 3196,  3590,  3981,  4370,  4756,  5139,  5520,  5897,
+	 6270,  6639,  7005,  7366,  7723,  8076,  8423,  8765,
+	 9102,  9434,  9760, 10080, 10394, 10702, 11003, 11297,
+	11585, 11866, 12140, 12406, 12665, 12916, 13160, 13395,
+	13623, 13842, 14053, 14256, 14449, 14635, 14811, 14978,
+	15137, 15286, 15426, 15557, 15679, 15791, 15893, 15986,
+	16069, 16143, 16207, 16261, 16305, 16340, 16364, 16379,
+	16384
+};
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static int16_t sun_sin (uint16_t angle)
+{
+	uint16_t x = angle & (SUN_QUARTER - 1);
+	uint8_t index;
+	int16_t a, b;
+
+	/* 2nd and 4th quarters run back down the table */
+	if (angle & SUN_QUARTER) {
+		x = SUN_QUARTER - x;
+	}
+	index = x >> 8;
+	a = pgm_read_word (&sun_sine[index]);
+	if (index < 64) {
+		b = pgm_read_word (&sun_sine[index + 1]);
+		a += ((int32_t)(b - a) * (x & 0xff)) >> 8;
+	}
+
+	/* 3rd and 4th quarters are negative */
+	if (angle & SUN_HALF) {
+		return -a;
+	}
+	return a;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static int16_t sun_cos (uint16_t angle)
+{
+	return sun_sin (angle + SUN_QUARTER);
+}
+
+/* ------------------------------------------------------------------ */
+/* 0..180 degrees, cos falls all the way so a bisection finds it */
+/* ------------------------------------------------------------------ */
+static uint16_t sun_acos (int16_t x)
+{
+	uint16_t lo = 0;
+	uint16_t hi = SUN_HALF;
+	uint16_t mid;
+
+	while ((hi - lo) > 1) {
+		mid = (lo + hi) / 2;
+		if (sun_cos (mid) > x) {
+			lo = mid;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void sun_toTime (int32_t seconds, rtc_time_t *time)
+{
+	uint16_t min;
+
+	while (seconds < 0) {
+		seconds += SUN_SECONDS_PER_DAY;
+	}
+	while (seconds >= SUN_SECONDS_PER_DAY) {
+		seconds -= SUN_SECONDS_PER_DAY;
+	}
+	min = seconds / 60;
+	time->m_sec = seconds - ((int32_t)min * 60);
+	time->m_min = min % 60;
+	time->m_hour = min / 60;
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+uint8_t SUN_GetTimes (uint16_t yday, sun_location_t *loc, int16_t utcOffset,
+					  rtc_time_t *open, rtc_time_t *close)
+{
+	uint16_t year = ((uint32_t)yday << 16) / 365;	/* fractional year */
+	int32_t c1 = sun_cos (year);
+	int32_t s1 = sun_sin (year);
+	int32_t c2 = sun_cos (year * 2);
+	int32_t s2 = sun_sin (year * 2);
+	int32_t c3 = sun_cos (year * 3);
+	int32_t s3 = sun_sin (year * 3);
+	int32_t decl, eot, num, den, x, noon, half;
+	uint16_t lat;
+
+	/* declination, radians Q16, then as an angle */
+	decl = 453 + ((-26209L * c1 + 4604L * s1 - 443L * c2 +
+				59L * s2 - 177L * c3 + 97L * s3) >> 14);
+	decl = (decl * 10430L) >> 16;
+
+	/* equation of time, seconds */
+	eot = 1 + ((26L * c1 - 441L * s1 - 201L * c2 - 562L * s2) >> 14);
+
+	/* 1/100 degree to an angle, 65536/36000 = 59652/32768 */
+	lat = (int16_t)(((int32_t)loc->m_lat * 59652L) >> 15);
+
+	/* cos of the hour angle at sunrise, Q14 */
+	num = (SUN_SIN_HORIZON * SUN_ONE) - ((int32_t)sun_sin (lat) * sun_sin ((uint16_t)decl));
+	den = ((int32_t)sun_cos (lat) * sun_cos ((uint16_t)decl)) >> 14;
+	if (den <= 0) {
+		return FALSE;
+	}
+	x = num / den;
+	if ((x >= SUN_ONE) || (x <= -SUN_ONE)) {
+		/* the sun stays down (or up) all day */
+		return FALSE;
+	}
+
+	/* half the day length, 86400/65536 = 675/512 seconds per step */
+	half = ((uint32_t)sun_acos (x) * 675) >> 9;
+	/* solar noon on the clock, 4 minutes per degree east of Greenwich */
+	noon = (SUN_SECONDS_PER_DAY / 2) - (((int32_t)loc->m_lon * 12) / 5) - eot +
+			((int32_t)utcOffset * 60);
+
+	sun_toTime (noon - half + ((int32_t)loc->m_open_offset * 60), open);
+	sun_toTime (noon + half + ((int32_t)loc->m_close_offset * 60), close);
+	return TRUE;
+}
+
+/* EOF */
@@ -0,0 +1,45 @@
+/*
+ * Filename		: sun-times.h
+ * Author		: Jon Cross
+ * Date			: 16/10/2026
+ * Description	: Sunrise and sunset times for the light door mode,
+ *				  fixed point only.
+ *
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+#ifndef _SUN_TIMES_H
+#define _SUN_TIMES_H
+
+#include <inttypes.h>
+#include "rtc.h"
+
+typedef struct {
+	int16_t	m_lat;			/* 1/100 degree, north is +ve */
+	int16_t	m_lon;			/* 1/100 degree, east is +ve */
+	int16_t	m_open_offset;	/* minutes after sunrise to open */
+	int16_t	m_close_offset;	/* minutes after sunset to close */
+} sun_location_t;
+
+/* yday is the day of the year, 0 = 1st January, and utcOffset the
+ * minutes the clock is ahead of UTC that day. Returns FALSE on days
+ * the sun doesn't rise or doesn't set (polar night/day). */
+uint8_t SUN_GetTimes (uint16_t yday, sun_location_t *loc, int16_t utcOffset,
+					  rtc_time_t *open, rtc_time_t *close);
+
+#endif /* #ifndef _SUN_TIMES_H */
+
+/* EOF */
@@ -0,0 +1,8 @@
+#ifndef _TEST_AVR_INTERRUPT_H
+#define _TEST_AVR_INTERRUPT_H
+
+#define cli()
+#define sei()
+#define ISR(vector)		void vector (void); void vector (void)
+
+#endif /* #ifndef _TEST_AVR_INTERRUPT_H */
@@ -0,0 +1,14 @@
+/* host stand ins for the registers rtc.c touches (Timer1 backend) */
+#ifndef _TEST_AVR_IO_H
+#define _TEST_AVR_IO_H
+#include <stdint.h>
+
+extern volatile uint8_t SREG, TCCR1A, TCCR1B, TIMSK1, TIFR1;
+extern volatile uint16_t TCNT1, OCR1A;
+
+#define CS10	0
+#define CS12	2
+#define WGM12	3
+#define OCF1A	1
+
+#endif /* #ifndef _TEST_AVR_IO_H */
@@ -0,0 +1,9 @@
+#ifndef _TEST_AVR_PGMSPACE_H
+#define _TEST_AVR_PGMSPACE_H
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(addr)		(*(const uint8_t *)(addr))
+#define pgm_read_word(addr)		(*(const uint16_t *)(addr))
+
+#endif /* #ifndef _TEST_AVR_PGMSPACE_H */
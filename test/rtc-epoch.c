@@ -0,0 +1,104 @@
+/*
+ * Filename		: rtc-epoch.c
+ * Description	: Host check for the clock near the epoch. A zone west
+ *				  of UTC on a clock at 1/1/2000 00:00 UTC (a new DS1307,
+ *				  or the POP-168 before its time is set) must show the
+ *				  first day, not a date 136 years on.
+ *
+ *				  make -C test
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA  02110-1301  USA.
+ */
+
+#include <stdio.h>
+#include <avr/io.h>
+
+#include "common.h"
+#include "rtc.h"
+
+volatile uint8_t SREG, TCCR1A, TCCR1B, TIMSK1, TIFR1;
+volatile uint16_t TCNT1, OCR1A;
+
+void TIMER1_COMPA_vect (void);
+
+static int failures = 0;
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void check (const char *what, int got, int want)
+{
+	if (got != want) {
+		printf ("FAIL %s: %d, expected %d\n", what, got, want);
+		failures++;
+	}
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+static void checkClock (const char *what, uint8_t hour, uint8_t min, uint8_t day)
+{
+	rtc_time_t time;
+	rtc_date_t date;
+
+	RTC_GetTime (&time);
+	RTC_GetDate (&date);
+	printf ("%-28s %02u:%02u:%02u %02u/%02u/%02u\n", what, time.m_hour,
+			time.m_min, time.m_sec, date.m_day, date.m_month, date.m_year);
+	check (what, time.m_hour, hour);
+	check (what, time.m_min, min);
+	check (what, date.m_day, day);
+	check (what, date.m_month, 1);
+	check (what, date.m_year, 0);
+}
+
+/* ------------------------------------------------------------------ */
+/* ------------------------------------------------------------------ */
+int main (void)
+{
+	rtc_time_t time;
+	uint16_t sec;
+
+	RTC_Init ();
+
+	/* New York, boot at the epoch: held at 00:00, not 19:00 in 2136 */
+	RTC_SetTimezone (-300, RTC_TZ_RULE_US);
+	checkClock ("west, epoch 0", 0, 0, 1);
+
+	/* the POP-168 boot default, 16:00 local */
+	time.m_hour = 16;
+	time.m_min = 0;
+	time.m_sec = 0;
+	RTC_SetTime (&time);
+	checkClock ("west, 16:00 default", 16, 0, 1);
+	for (sec=0; sec<3600; sec++) {
+		TIMER1_COMPA_vect ();
+	}
+	checkClock ("west, an hour later", 17, 0, 1);
+
+	/* east of UTC, a local time before the epoch in UTC holds at it */
+	RTC_SetTimezone (60, RTC_TZ_RULE_EU);
+	time.m_hour = 0;
+	time.m_min = 30;
+	RTC_SetTime (&time);
+	checkClock ("east, before the epoch", 1, 0, 1);
+
+	if (failures) {
+		printf ("%d failed\n", failures);
+		return 1;
+	}
+	printf ("ok\n");
+	return 0;
+}
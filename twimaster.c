@@ -7,7 +7,9 @@
 * Usage:    API compatible with I2C Software Library i2cmaster.h
 **************************************************************************/
 #include <inttypes.h>
+#include <avr/interrupt.h>
 #include <compat/twi.h>
+#include <util/delay.h>
 
 #include <i2cmaster.h>
 
@@ -18,8 +20,145 @@
 #define F_CPU 16000000UL
 #endif
 
-/* I2C clock in Hz */
-#define SCL_CLOCK  10000L
+/* default I2C clock in Hz, used for devices without a speed profile */
+#define SCL_CLOCK  100000L
+
+/* slowest clock the boot probe will fall back to */
+#define SCL_CLOCK_MIN  10000L
+
+/* per-device speed profiles */
+#define I2C_PROFILE_MAX  4
+
+typedef struct {
+    uint8_t addr;
+    uint8_t twbr;
+    uint8_t twps;
+} i2c_profile_t;
+
+static i2c_profile_t i2c_profile[I2C_PROFILE_MAX];
+static uint8_t i2c_profiles;
+static uint8_t i2c_default_twbr;
+static uint8_t i2c_default_twps;
+
+/* transaction queue, must be a power of 2 */
+#define I2C_QUEUE_LEN   4
+#define I2C_QUEUE_MASK  (I2C_QUEUE_LEN - 1)
+
+#define TWCR_GO   ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+
+/* longest time without any bus progress before the bus is recovered,
+ * one byte at SCL_CLOCK_MIN takes 900us */
+#define I2C_TIMEOUT_US     2000
+
+/* ack polling attempts in i2c_start_wait */
+#define I2C_START_RETRIES  50
+
+/* TWI pins, driven by hand during bus recovery */
+#if defined(__AVR_ATmega32U4__)
+#define I2C_PORT  PORTD
+#define I2C_DDR   DDRD
+#define I2C_PIN   PIND
+#define I2C_SCL   PD0
+#define I2C_SDA   PD1
+#else /* ATmega48/88/168/328 */
+#define I2C_PORT  PORTC
+#define I2C_DDR   DDRC
+#define I2C_PIN   PINC
+#define I2C_SCL   PC5
+#define I2C_SDA   PC4
+#endif
+
+static i2c_xfer_t * volatile i2c_queue[I2C_QUEUE_LEN];
+static volatile uint8_t i2c_head;      /* next transaction to run (ISR) */
+static volatile uint8_t i2c_tail;      /* next free slot (main loop) */
+static volatile uint8_t i2c_active;    /* engine owns the bus */
+static uint8_t i2c_index;              /* byte position in current phase */
+static volatile uint8_t i2c_progress;  /* bumped on every TWI interrupt */
+static uint8_t i2c_error;              /* sticky error for byte reads */
+
+
+/*************************************************************************
+ Spin while *flag == value. Gives up, recovering the bus, once the TWI
+ interrupt has not fired for I2C_TIMEOUT_US.
+
+ Return:  0 flag changed, 1 bus was recovered
+*************************************************************************/
+static uint8_t i2c_wait_while(volatile unsigned char *flag, uint8_t value)
+{
+    uint16_t budget = I2C_TIMEOUT_US;
+    uint8_t  seen = i2c_progress;
+
+    while ( *flag == value )
+    {
+        if ( seen != i2c_progress )
+        {
+            seen = i2c_progress;
+            budget = I2C_TIMEOUT_US;
+        }
+        else if ( --budget == 0 )
+        {
+            i2c_recover();
+            return 1;
+        }
+        _delay_us(1);
+    }
+    return 0;
+
+}/* i2c_wait_while */
+
+
+/*************************************************************************
+ Wait for the queued engine to release the bus
+*************************************************************************/
+static void i2c_wait_idle(void)
+{
+    i2c_wait_while(&i2c_active, 1);
+
+}/* i2c_wait_idle */
+
+
+/*************************************************************************
+ Work out TWBR and the prescaler for a SCL clock.
+ SCL = F_CPU / (16 + 2 * TWBR * 4^TWPS)
+*************************************************************************/
+static void i2c_calc_speed(unsigned long scl_hz, uint8_t *twbr, uint8_t *twps)
+{
+    unsigned long div = ((F_CPU / scl_hz) - 16) / 2;
+    uint8_t ps = 0;
+
+    while ( (div > 255) && (ps < 3) )
+    {
+        div = (div + 3) / 4;   /* round up, never faster than asked */
+        ps++;
+    }
+    *twbr = (div > 255) ? 255 : div;
+    *twps = ps;
+
+}/* i2c_calc_speed */
+
+
+/*************************************************************************
+ Load TWBR/TWSR for the device about to be addressed. Only called while
+ the bus is idle or between a STOP and the next START.
+*************************************************************************/
+static void i2c_apply_speed(uint8_t address)
+{
+    uint8_t i;
+
+    address &= ~I2C_READ;
+    for ( i = 0; i < i2c_profiles; i++ )
+    {
+        if ( i2c_profile[i].addr == address )
+        {
+            TWBR = i2c_profile[i].twbr;
+            TWSR = i2c_profile[i].twps;
+            return;
+        }
+    }
+    TWBR = i2c_default_twbr;
+    TWSR = i2c_default_twps;
+
+}/* i2c_apply_speed */
 
 
 /*************************************************************************
@@ -27,93 +166,161 @@
 *************************************************************************/
 void i2c_init(void)
 {
-  /* initialize TWI clock: 100 kHz clock, TWPS = 0 => prescaler = 1 */
-  
-  TWSR = 0;                         /* no prescaler */
-  TWBR = ((F_CPU/SCL_CLOCK)-16)/2;  /* must be > 10 for stable operation */
+  /* initialize TWI clock: 100 kHz default, per-device profiles on top */
+  i2c_calc_speed(SCL_CLOCK, &i2c_default_twbr, &i2c_default_twps);
+  i2c_profiles = 0;
+
+  TWSR = i2c_default_twps;
+  TWBR = i2c_default_twbr;          /* must be > 10 for stable operation */
 
 }/* i2c_init */
 
 
+/*************************************************************************
+ Set the SCL clock used whenever a device is addressed
+
+ Input:   device address (R/W bit ignored) and clock in Hz
+ Return:  0 profile stored
+          1 profile table full
+*************************************************************************/
+unsigned char i2c_set_speed(unsigned char address, unsigned long scl_hz)
+{
+    uint8_t i;
+
+    address &= ~I2C_READ;
+    for ( i = 0; i < i2c_profiles; i++ )
+    {
+        if ( i2c_profile[i].addr == address ) break;
+    }
+    if ( i == I2C_PROFILE_MAX ) return 1;
+    if ( i == i2c_profiles ) i2c_profiles++;
+
+    i2c_profile[i].addr = address;
+    i2c_calc_speed(scl_hz, &i2c_profile[i].twbr, &i2c_profile[i].twps);
+    return 0;
+
+}/* i2c_set_speed */
+
+
+/*************************************************************************
+ Find the fastest clock a device answers at. Starts at scl_hz and halves
+ the clock after every NACK down to SCL_CLOCK_MIN. The result is stored
+ as the device's speed profile.
+
+ Input:   device address (R/W bit ignored) and fastest clock in Hz
+ Return:  clock in use, 0 if the device never answered
+*************************************************************************/
+unsigned long i2c_probe(unsigned char address, unsigned long scl_hz)
+{
+    i2c_xfer_t xfer;
+
+    xfer.addr = address & ~I2C_READ;
+    xfer.wbuf = 0;
+    xfer.wlen = 0;
+    xfer.rbuf = 0;
+    xfer.rlen = 0;
+    xfer.done = 0;
+
+    for ( ; scl_hz >= SCL_CLOCK_MIN; scl_hz /= 2 )
+    {
+        if ( i2c_set_speed(address, scl_hz) ) return 0;
+        if ( i2c_transfer(&xfer) == I2C_XFER_DONE ) return scl_hz;
+    }
+
+    // nothing answered, leave it on the slowest clock
+    i2c_set_speed(address, SCL_CLOCK_MIN);
+    return 0;
+
+}/* i2c_probe */
+
+
+/*************************************************************************
+ Wait until TWINT is set (bit = TWINT, set = 1) or TWSTO has cleared
+ (bit = TWSTO, set = 0). Gives up after I2C_TIMEOUT_US and recovers
+ the bus.
+
+ Return:  I2C_OK or I2C_ERR_TIMEOUT
+*************************************************************************/
+static unsigned char i2c_wait_twcr(uint8_t bit, uint8_t set)
+{
+    uint16_t budget = I2C_TIMEOUT_US;
+
+    while ( ((TWCR & (1<<bit)) != 0) != set )
+    {
+        if ( --budget == 0 )
+        {
+            i2c_recover();
+            i2c_error = I2C_ERR_TIMEOUT;
+            return I2C_ERR_TIMEOUT;
+        }
+        _delay_us(1);
+    }
+    return I2C_OK;
+
+}/* i2c_wait_twcr */
+
+
 /*************************************************************************	
   Issues a start condition and sends address and transfer direction.
-  return 0 = device accessible, 1= failed to access device
+  return I2C_OK = device accessible, I2C_ERR_NACK = failed to access device,
+  I2C_ERR_TIMEOUT = bus stuck and was recovered
 *************************************************************************/
 unsigned char i2c_start(unsigned char address)
 {
     uint8_t   twst;
 
+	// let any queued transactions finish first
+	i2c_wait_idle();
+	i2c_apply_speed(address);
+
 	// send START condition
 	TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
 
 	// wait until transmission completed
-	while(!(TWCR & (1<<TWINT)));
+	if ( i2c_wait_twcr(TWINT, 1) ) return I2C_ERR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits.
 	twst = TW_STATUS & 0xF8;
-	if ( (twst != TW_START) && (twst != TW_REP_START)) return 1;
+	if ( (twst != TW_START) && (twst != TW_REP_START)) return I2C_ERR_NACK;
 
 	// send device address
 	TWDR = address;
 	TWCR = (1<<TWINT) | (1<<TWEN);
 
 	// wail until transmission completed and ACK/NACK has been received
-	while(!(TWCR & (1<<TWINT)));
+	if ( i2c_wait_twcr(TWINT, 1) ) return I2C_ERR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits.
 	twst = TW_STATUS & 0xF8;
-	if ( (twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK) ) return 1;
+	if ( (twst != TW_MT_SLA_ACK) && (twst != TW_MR_SLA_ACK) ) return I2C_ERR_NACK;
 
-	return 0;
+	return I2C_OK;
 
 }/* i2c_start */
 
 
 /*************************************************************************
  Issues a start condition and sends address and transfer direction.
- If device is busy, use ack polling to wait until device is ready
+ If device is busy, use ack polling to wait until device is ready.
+ Gives up after I2C_START_RETRIES attempts.
  
  Input:   address and transfer direction of I2C device
+ Return:  I2C_OK, I2C_ERR_NACK or I2C_ERR_TIMEOUT
 *************************************************************************/
-void i2c_start_wait(unsigned char address)
+unsigned char i2c_start_wait(unsigned char address)
 {
-    uint8_t   twst;
+    uint8_t   retry;
+    uint8_t   ret = I2C_ERR_NACK;
 
-
-    while ( 1 )
+    for ( retry = 0; retry < I2C_START_RETRIES; retry++ )
     {
-	    // send START condition
-	    TWCR = (1<<TWINT) | (1<<TWSTA) | (1<<TWEN);
-    
-    	// wait until transmission completed
-    	while(!(TWCR & (1<<TWINT)));
-    
-    	// check value of TWI Status Register. Mask prescaler bits.
-    	twst = TW_STATUS & 0xF8;
-    	if ( (twst != TW_START) && (twst != TW_REP_START)) continue;
-    
-    	// send device address
-    	TWDR = address;
-    	TWCR = (1<<TWINT) | (1<<TWEN);
-    
-    	// wail until transmission completed
-    	while(!(TWCR & (1<<TWINT)));
-    
-    	// check value of TWI Status Register. Mask prescaler bits.
-    	twst = TW_STATUS & 0xF8;
-    	if ( (twst == TW_MT_SLA_NACK )||(twst ==TW_MR_DATA_NACK) ) 
-    	{    	    
-    	    /* device busy, send stop condition to terminate write operation */
-	        TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
-	        
-	        // wait until stop condition is executed and bus released
-	        while(TWCR & (1<<TWSTO));
-	        
-    	    continue;
-    	}
-    	//if( twst != TW_MT_SLA_ACK) return 1;
-    	break;
-     }
+        ret = i2c_start(address);
+        if ( ret != I2C_ERR_NACK ) break;
+
+        /* device busy, send stop condition to terminate write operation */
+        i2c_stop();
+    }
+    return ret;
 
 }/* i2c_start_wait */
 
@@ -125,6 +332,7 @@ void i2c_start_wait(unsigned char address)
  
  Return:  0 device accessible
           1 failed to access device
+          2 bus timeout
 *************************************************************************/
 unsigned char i2c_rep_start(unsigned char address)
 {
@@ -142,7 +350,7 @@ void i2c_stop(void)
 	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
 	
 	// wait until stop condition is executed and bus released
-	while(TWCR & (1<<TWSTO));
+	i2c_wait_twcr(TWSTO, 0);
 
 }/* i2c_stop */
 
@@ -153,6 +361,7 @@ void i2c_stop(void)
   Input:    byte to be transfered
   Return:   0 write successful 
             1 write failed
+            2 bus timeout
 *************************************************************************/
 unsigned char i2c_write( unsigned char data )
 {	
@@ -163,12 +372,12 @@ unsigned char i2c_write( unsigned char data )
 	TWCR = (1<<TWINT) | (1<<TWEN);
 
 	// wait until transmission completed
-	while(!(TWCR & (1<<TWINT)));
+	if ( i2c_wait_twcr(TWINT, 1) ) return I2C_ERR_TIMEOUT;
 
 	// check value of TWI Status Register. Mask prescaler bits
 	twst = TW_STATUS & 0xF8;
-	if( twst != TW_MT_DATA_ACK) return 1;
-	return 0;
+	if( twst != TW_MT_DATA_ACK) return I2C_ERR_NACK;
+	return I2C_OK;
 
 }/* i2c_write */
 
@@ -176,12 +385,12 @@ unsigned char i2c_write( unsigned char data )
 /*************************************************************************
  Read one byte from the I2C device, request more data from device 
  
- Return:  byte read from I2C device
+ Return:  byte read from I2C device, 0xff on timeout (see i2c_get_error)
 *************************************************************************/
 unsigned char i2c_readAck(void)
 {
 	TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWEA);
-	while(!(TWCR & (1<<TWINT)));    
+	if ( i2c_wait_twcr(TWINT, 1) ) return 0xff;
 
     return TWDR;
 
@@ -191,13 +400,272 @@ unsigned char i2c_readAck(void)
 /*************************************************************************
  Read one byte from the I2C device, read is followed by a stop condition 
  
- Return:  byte read from I2C device
+ Return:  byte read from I2C device, 0xff on timeout (see i2c_get_error)
 *************************************************************************/
 unsigned char i2c_readNak(void)
 {
 	TWCR = (1<<TWINT) | (1<<TWEN);
-	while(!(TWCR & (1<<TWINT)));
+	if ( i2c_wait_twcr(TWINT, 1) ) return 0xff;
 	
     return TWDR;
 
 }/* i2c_readNak */
+
+
+/*************************************************************************
+ Return and clear the sticky error left by a timed out byte read or stop
+*************************************************************************/
+unsigned char i2c_get_error(void)
+{
+    uint8_t err = i2c_error;
+    i2c_error = I2C_OK;
+    return err;
+
+}/* i2c_get_error */
+
+
+/*************************************************************************
+ Bus clear. Takes the pins off the TWI unit, clocks SCL until a slave
+ holding SDA low lets go (at most 9 clocks), sends a STOP and re-enables
+ the TWI. Every queued transaction is failed with I2C_XFER_TIMEOUT.
+*************************************************************************/
+void i2c_recover(void)
+{
+    i2c_xfer_t *xfer;
+    uint8_t   sreg;
+    uint8_t   i;
+
+    sreg = SREG;
+    cli();
+
+    // open drain by hand: PORT low, DDR 1 = pull low, DDR 0 = release
+    TWCR = 0;
+    I2C_PORT &= ~((1<<I2C_SCL) | (1<<I2C_SDA));
+    I2C_DDR  &= ~((1<<I2C_SCL) | (1<<I2C_SDA));
+    _delay_us(5);
+
+    for ( i = 0; (i < 9) && !(I2C_PIN & (1<<I2C_SDA)); i++ )
+    {
+        I2C_DDR |= (1<<I2C_SCL);
+        _delay_us(5);
+        I2C_DDR &= ~(1<<I2C_SCL);
+        _delay_us(5);
+    }
+
+    // STOP: SDA rises while SCL is high
+    I2C_DDR |= (1<<I2C_SCL);
+    _delay_us(5);
+    I2C_DDR |= (1<<I2C_SDA);
+    _delay_us(5);
+    I2C_DDR &= ~(1<<I2C_SCL);
+    _delay_us(5);
+    I2C_DDR &= ~(1<<I2C_SDA);
+    _delay_us(5);
+
+    // drop everything that was queued
+    while ( i2c_head != i2c_tail )
+    {
+        xfer = i2c_queue[i2c_head];
+        i2c_head = (i2c_head + 1) & I2C_QUEUE_MASK;
+        xfer->status = I2C_XFER_TIMEOUT;
+        if ( xfer->done ) xfer->done(xfer);
+    }
+    i2c_active = 0;
+
+    // re-init
+    TWCR = (1<<TWEN);
+
+    SREG = sreg;
+
+}/* i2c_recover */
+
+
+/*************************************************************************
+ Queue a transaction for the interrupt driven engine. The descriptor is
+ owned by the engine until its status leaves I2C_XFER_PENDING.
+
+ A STOP from the previous transaction may still be going out when the
+ engine is idle. That is waited for with interrupts on and within
+ I2C_TIMEOUT_US; a STOP that never clears recovers the bus and the
+ transaction is not started.
+
+ Input:   transaction descriptor
+ Return:  0 queued
+          1 queue full
+          I2C_ERR_TIMEOUT bus stuck, it has been recovered
+*************************************************************************/
+unsigned char i2c_submit(i2c_xfer_t *xfer)
+{
+    uint8_t   sreg;
+    uint8_t   next = (i2c_tail + 1) & I2C_QUEUE_MASK;
+
+    if ( next == i2c_head ) return 1;
+
+    for (;;)
+    {
+        if ( !i2c_active && i2c_wait_twcr(TWSTO, 0) )
+        {
+            xfer->status = I2C_XFER_TIMEOUT;
+            return I2C_ERR_TIMEOUT;
+        }
+        sreg = SREG;
+        cli();
+        // engine still running (it picks the new entry up), or bus free
+        if ( i2c_active || !(TWCR & (1<<TWSTO)) ) break;
+        // it finished and sent its STOP since the wait, at most once more
+        SREG = sreg;
+    }
+
+    xfer->status = I2C_XFER_PENDING;
+    i2c_queue[i2c_tail] = xfer;
+    i2c_tail = next;
+    if ( !i2c_active )
+    {
+        i2c_active = 1;
+        i2c_apply_speed(xfer->addr);
+        TWCR = TWCR_GO | (1<<TWSTA);
+    }
+    SREG = sreg;
+
+    return 0;
+
+}/* i2c_submit */
+
+
+/*************************************************************************
+ Wait for a queued transaction to complete. The wait is bounded: if the
+ engine makes no progress for I2C_TIMEOUT_US the bus is recovered.
+
+ Input:   transaction descriptor
+ Return:  I2C_XFER_DONE, I2C_XFER_ERROR or I2C_XFER_TIMEOUT
+*************************************************************************/
+unsigned char i2c_wait(i2c_xfer_t *xfer)
+{
+    i2c_wait_while(&xfer->status, I2C_XFER_PENDING);
+    return xfer->status;
+
+}/* i2c_wait */
+
+
+/*************************************************************************
+ Queue a transaction, waiting (bounded) for a free queue slot
+
+ Input:   transaction descriptor
+*************************************************************************/
+void i2c_submit_wait(i2c_xfer_t *xfer)
+{
+    // a stall empties the queue, so this always terminates. A stuck
+    // STOP leaves the status at I2C_XFER_TIMEOUT for i2c_wait
+    while ( i2c_submit(xfer) == 1 )
+    {
+        i2c_wait(i2c_queue[i2c_head]);
+    }
+
+}/* i2c_submit_wait */
+
+
+/*************************************************************************
+ Queue a transaction and wait for it to complete
+
+ Input:   transaction descriptor
+ Return:  I2C_XFER_DONE, I2C_XFER_ERROR or I2C_XFER_TIMEOUT
+*************************************************************************/
+unsigned char i2c_transfer(i2c_xfer_t *xfer)
+{
+    i2c_submit_wait(xfer);
+    return i2c_wait(xfer);
+
+}/* i2c_transfer */
+
+
+/*************************************************************************
+ Finish the current transaction, release the bus and start the next one
+*************************************************************************/
+static void i2c_complete(uint8_t status)
+{
+    i2c_xfer_t *xfer = i2c_queue[i2c_head];
+
+    i2c_head = (i2c_head + 1) & I2C_QUEUE_MASK;
+    xfer->status = status;
+    if ( xfer->done ) xfer->done(xfer);
+
+    if ( i2c_head != i2c_tail )
+    {
+        // STOP followed by START for the next transaction
+        i2c_apply_speed(i2c_queue[i2c_head]->addr);
+        TWCR = TWCR_GO | (1<<TWSTO) | (1<<TWSTA);
+    }
+    else
+    {
+        TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
+        i2c_active = 0;
+    }
+
+}/* i2c_complete */
+
+
+/*************************************************************************
+ TWI state machine. Each transaction writes wlen bytes and then, after
+ a repeated start, reads rlen bytes. Either phase may be empty.
+*************************************************************************/
+ISR(TWI_vect)
+{
+    i2c_xfer_t *xfer = i2c_queue[i2c_head];
+
+    i2c_progress++;
+
+    switch ( TW_STATUS )
+    {
+    case TW_START:
+        i2c_index = 0;
+        // an empty transaction addresses the device for writing (probe)
+        TWDR = xfer->addr | ((xfer->wlen || !xfer->rlen) ? I2C_WRITE : I2C_READ);
+        TWCR = TWCR_GO;
+        break;
+
+    case TW_REP_START:
+        i2c_index = 0;
+        TWDR = xfer->addr | I2C_READ;
+        TWCR = TWCR_GO;
+        break;
+
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+        if ( i2c_index < xfer->wlen )
+        {
+            TWDR = xfer->wbuf[i2c_index++];
+            TWCR = TWCR_GO;
+        }
+        else if ( xfer->rlen )
+        {
+            TWCR = TWCR_GO | (1<<TWSTA);
+        }
+        else
+        {
+            i2c_complete(I2C_XFER_DONE);
+        }
+        break;
+
+    case TW_MR_DATA_ACK:
+        xfer->rbuf[i2c_index++] = TWDR;
+        /* fall through */
+    case TW_MR_SLA_ACK:
+        // ACK every byte but the last
+        if ( i2c_index + 1 < xfer->rlen )
+            TWCR = TWCR_GO | (1<<TWEA);
+        else
+            TWCR = TWCR_GO;
+        break;
+
+    case TW_MR_DATA_NACK:
+        xfer->rbuf[i2c_index] = TWDR;
+        i2c_complete(I2C_XFER_DONE);
+        break;
+
+    default:
+        // SLA/data NACK, arbitration lost or bus error
+        i2c_complete(I2C_XFER_ERROR);
+        break;
+    }
+
+}/* ISR(TWI_vect) */